@@ -0,0 +1,168 @@
+#!/bin/sh
+#
+# end to end benchmark of zz80asm
+# the sources of every mix and size are generated with gen and assembled
+# runs times with -T j, the fastest run gives the lines per second, the
+# peak RSS and the times of the phases, the counters of the kernels and
+# a checksum of the object are written as JSON to results; with a
+# baseline, a previous results file, the lines per second and the
+# objects are compared to it
+# every mix runs the whole assembler, they only weight the kernels:
+# code the lookups of opcodes and registers, equ and label the symbol
+# table, expr the evaluation of expressions, defb the writing of the
+# object, -a -l the listing; bench/micro, make micro, times the kernels
+# alone in loops;
+# the corpus mixes are also assembled into a binary, which must be
+# identical to the bytes expected by gen, corpus-u with -U and corpus-n
+# with -c z80n
+#
+# usage: bench.sh [-a args] [-b baseline] [-m mixes] [-n runs]
+#	 [-o results] [-s sizes] zz80asm gen
+
+usage() {
+	echo "usage: bench.sh [-a args] [-b baseline] [-m mixes]" \
+	    "[-n runs] [-o results] [-s sizes] zz80asm gen" >&2
+	exit 1
+}
+
+args=
+baseline=
+mixes="code defb equ include label expr mixed corpus corpus-u corpus-n"
+runs=3
+results=results.json
+sizes="1000 10000 100000"
+while getopts a:b:m:n:o:s: ch; do
+	case $ch in
+	a)	args=$OPTARG ;;
+	b)	baseline=$OPTARG ;;
+	m)	mixes=$OPTARG ;;
+	n)	runs=$OPTARG ;;
+	o)	results=$OPTARG ;;
+	s)	sizes=$OPTARG ;;
+	*)	usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 2 ] || usage
+if [ -n "$baseline" ] && [ ! -f "$baseline" ]; then
+	echo "bench.sh: no baseline $baseline" >&2
+	baseline=
+fi
+asm=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+gen=$2
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+trap 'exit 1' HUP INT TERM
+
+sep=
+{
+	echo '{ "cases": ['
+	for m in $mixes; do
+		for n in $sizes; do
+			rm -rf "$tmp/src" "$tmp"/run*
+			mkdir "$tmp/src" && "$gen" "$m" "$n" "$tmp/src" ||
+			    exit 1
+			case $m in
+			corpus-u)	cpu="-U" ;;
+			corpus-n)	cpu="-c z80n" ;;
+			*)		cpu= ;;
+			esac
+			i=0
+			while [ $i -lt "$runs" ]; do
+				(cd "$tmp/src" && "$asm" -T j $cpu $args \
+				    -o ../out.hex main.asm) > "$tmp/run$i" ||
+				    exit 1
+				i=$((i + 1))
+			done
+			if [ -f "$tmp/src/expect.bin" ]; then
+				(cd "$tmp/src" &&
+				    "$asm" $cpu -f b -o ../out.bin main.asm &&
+				    cmp ../out.bin expect.bin) >&2 || {
+					echo "bench.sh: corpus of $n" \
+					    "lines differs from the" \
+					    "expected bytes" >&2
+					exit 1
+				}
+			fi
+			sum=$(cksum < "$tmp/out.hex" | awk '{ print $1 }')
+			printf '%s' "$sep"
+			awk -v mix="$m" -v size="$n" -v sum="$sum" '
+			FNR == 1 && NR > 1 { best() }
+			/"wall"/ {
+				gsub(/[":,]/, "", $1)
+				sub(/,/, "", $4)
+				if (!($1 in wall))
+					keys[np++] = $1
+				wall[$1] = $4
+				total += $4
+			}
+			/"(lines_pass1|search_op|get_reg|get_sym|eval)"/ ||
+			/"sym_probes"/ {
+				gsub(/[":,]/, "", $1)
+				sub(/,/, "", $2)
+				if (!($1 in cnt))
+					ckeys[nc++] = $1
+				cnt[$1] = $2
+			}
+			/"maxrss_kb"/ { rss = $2 }
+			END {
+				best()
+				printf "  { \"mix\": \"%s\", \"lines\": %d, ",
+				    mix, size
+				printf "\"lines_per_sec\": %.0f, ",
+				    (btotal > 0) ? size / btotal : 0
+				printf "\"maxrss_kb\": %d, \"cksum\": %s, ",
+				    brss, sum
+				printf "\"total\": %.6f", btotal
+				for (k = 0; k < np; k++)
+					printf ", \"%s\": %s", keys[k],
+					    bwall[keys[k]]
+				for (k = 0; k < nc; k++)
+					printf ", \"%s\": %s", ckeys[k],
+					    cnt[ckeys[k]]
+				printf " }"
+			}
+			function best() {
+				if (nruns++ == 0 || total < btotal) {
+					btotal = total
+					brss = rss
+					for (k in wall)
+						bwall[k] = wall[k]
+				}
+				total = 0
+			}' "$tmp"/run*
+			sep=",
+"
+		done
+	done
+	printf '\n] }\n'
+} > "$results" || exit 1
+
+# print the cases, compared to the baseline
+awk '
+function get(s, k) {
+	if (!match(s, "\"" k "\": \"?[^,\" ]*"))
+		return ""
+	s = substr(s, RSTART + length(k) + 4, RLENGTH - length(k) - 4)
+	sub(/^"/, "", s)
+	return s
+}
+/"mix"/ {
+	c = get($0, "mix") " " get($0, "lines")
+	if (FILENAME != ARGV[ARGC - 1]) {
+		base[c] = get($0, "lines_per_sec")
+		bsum[c] = get($0, "cksum")
+		next
+	}
+	printf "%-8s %9s %12s %10s", get($0, "mix"), get($0, "lines"),
+	    get($0, "lines_per_sec"), get($0, "maxrss_kb")
+	if (base[c] > 0)
+		printf " %12s %+7.1f%%%s", base[c],
+		    100 * (get($0, "lines_per_sec") / base[c] - 1),
+		    (bsum[c] != get($0, "cksum")) ? "  object differs" : ""
+	printf "\n"
+}
+BEGIN {
+	printf "%-8s %9s %12s %10s %12s %8s\n", "mix", "lines", "lines/s",
+	    "RSS KB", "baseline", "change"
+}' $baseline "$results"
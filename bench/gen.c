@@ -0,0 +1,822 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	generator of synthetic sources for the benchmark
+ *	writes main.asm of a given no. of lines and mix into a directory,
+ *	the same seed always gives the same sources
+ *	mixes:	code	instruction-dense code
+ *		defb	DEFB, DEFW and DEFM tables
+ *		equ	EQU-heavy header, symbols defined by earlier ones
+ *		include	code spread over a binary tree of INCLUDE files
+ *		label	a label on every line, jumps and calls between them
+ *		expr	long expressions of constants
+ *		mixed	all of the above, line by line
+ *		corpus	every documented instruction form, repeated, and
+ *			its expected bytes in expect.bin, decoded from the
+ *			opcode tables so an encoding change is detected
+ *		corpus-u every undocumented instruction form of -U
+ *		corpus-n every Z80N instruction, assembled with -c z80n
+ *	labels are at most 8 characters, the significant length of symbols,
+ *	in mix mixed the labels are only referenced backwards
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern char	*__progname;
+
+static uint64_t	 seed = 1;		/* state of the generator */
+static unsigned long nlines;		/* no. of lines to write */
+static unsigned long nlabels;		/* no. of labels written */
+static unsigned long nequs;		/* no. of EQU's written */
+static int	 fwd_flag;		/* labels on all lines, jump forward */
+static int	 depth = 6;		/* depth of the INCLUDE tree */
+static const char *dir;			/* output directory */
+
+static const char *mixes[] = {		/* names of the mixes */
+	"code", "defb", "equ", "include", "label", "expr", "mixed", "corpus",
+	"corpus-u", "corpus-n"
+};
+static const char mixc[] = "cdeilxmkun";	/* letters of the mixes */
+static const char *pairs[] = { "bc", "de", "hl" };
+static const char *ops[] = {		/* instructions of mix code */
+	"ld a,%n", "ld %r,%r", "ld %r,%n", "ld hl,%w", "ld de,%w",
+	"ld bc,%w", "ld a,(hl)", "ld (hl),%r", "ld (ix+%d),a",
+	"ld %r,(iy+%d)", "ld (%w),a", "ld a,(%w)", "ld hl,(%w)",
+	"add a,%r", "adc a,%n", "sub %r", "sbc a,%r", "and %n", "xor %r",
+	"or %r", "cp %n", "inc %r", "dec %r", "inc %p", "dec %p",
+	"add hl,%p", "sbc hl,%p", "push %p", "pop %p", "ex de,hl",
+	"bit %b,%r", "set %b,(hl)", "res %b,(ix+%d)", "rlc %r", "srl %r",
+	"rla", "rrca", "djnz $", "jr nz,$+2", "jp z,$+3", "out (%n),a",
+	"in a,(%n)", "ldir", "cpl", "neg", "nop"
+};
+
+static const char *regs[] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
+static const char *rps[] = { "BC", "DE", "HL", "SP" };
+static const char *rps2[] = { "BC", "DE", "HL", "AF" };
+static const char *conds[] = { "NZ", "Z", "NC", "C", "PO", "PE", "P", "M" };
+static const char *alus[] = {
+	"ADD A,", "ADC A,", "SUB ", "SBC A,", "AND ", "XOR ", "OR ", "CP "
+};
+static const char *rots[] = {
+	"RLC", "RRC", "RL", "RR", "SLA", "SRA", NULL, "SRL"
+};
+static const char *accs[] = {
+	"RLCA", "RRCA", "RLA", "RRA", "DAA", "CPL", "SCF", "CCF"
+};
+static const char *bits[] = { NULL, "BIT", "RES", "SET" };
+static const char *xtra[] = {
+	"RET", "EXX", "JP (HL)", "LD SP,HL",
+	"EX (SP),HL", "EX DE,HL", "DI", "EI"
+};
+static const char *eds[] = {
+	"LD I,A", "LD R,A", "LD A,I", "LD A,R", "RRD", "RLD"
+};
+static const char *blks[4][4] = {
+	{ "LDI", "CPI", "INI", "OUTI" }, { "LDD", "CPD", "IND", "OUTD" },
+	{ "LDIR", "CPIR", "INIR", "OTIR" }, { "LDDR", "CPDR", "INDR", "OTDR" }
+};
+
+/*
+ *	structure instruction forms with their bytes
+ */
+struct form {
+	const char	*f_text;
+	int		 f_len;
+	uint8_t		 f_bytes[4];
+};
+
+static const struct form z80n[] = {	/* Z80N, from the Next's list */
+	{ "SWAPNIB",		2, { 0xed, 0x23 } },
+	{ "MIRROR A",		2, { 0xed, 0x24 } },
+	{ "TEST 12H",		3, { 0xed, 0x27, 0x12 } },
+	{ "BSLA DE,B",		2, { 0xed, 0x28 } },
+	{ "BSRA DE,B",		2, { 0xed, 0x29 } },
+	{ "BSRL DE,B",		2, { 0xed, 0x2a } },
+	{ "BSRF DE,B",		2, { 0xed, 0x2b } },
+	{ "BRLC DE,B",		2, { 0xed, 0x2c } },
+	{ "MUL D,E",		2, { 0xed, 0x30 } },
+	{ "ADD HL,A",		2, { 0xed, 0x31 } },
+	{ "ADD DE,A",		2, { 0xed, 0x32 } },
+	{ "ADD BC,A",		2, { 0xed, 0x33 } },
+	{ "ADD HL,3456H",	4, { 0xed, 0x34, 0x56, 0x34 } },
+	{ "ADD DE,3456H",	4, { 0xed, 0x35, 0x56, 0x34 } },
+	{ "ADD BC,3456H",	4, { 0xed, 0x36, 0x56, 0x34 } },
+	{ "PUSH 3456H",		4, { 0xed, 0x8a, 0x34, 0x56 } },
+	{ "OUTINB",		2, { 0xed, 0x90 } },
+	{ "NEXTREG 12H,78H",	4, { 0xed, 0x91, 0x12, 0x78 } },
+	{ "NEXTREG 12H,A",	3, { 0xed, 0x92, 0x12 } },
+	{ "PIXELDN",		2, { 0xed, 0x93 } },
+	{ "PIXELAD",		2, { 0xed, 0x94 } },
+	{ "SETAE",		2, { 0xed, 0x95 } },
+	{ "JP (C)",		2, { 0xed, 0x98 } },
+	{ "LDIX",		2, { 0xed, 0xa4 } },
+	{ "LDWS",		2, { 0xed, 0xa5 } },
+	{ "LDDX",		2, { 0xed, 0xac } },
+	{ "LDIRX",		2, { 0xed, 0xb4 } },
+	{ "LDPIRX",		2, { 0xed, 0xb7 } },
+	{ "LDDRX",		2, { 0xed, 0xbc } },
+	{ NULL,			0, { 0 } }
+};
+
+static uint32_t	rnd(void);
+static void	put_op(FILE * const);
+static void	put_expr(FILE * const, const int);
+static int	dis_base(const int, char * const);
+static void	put_ins(FILE * const, FILE * const, const char * const,
+		    const uint8_t * const, const int);
+static void	put_corpus(FILE * const, FILE * const, unsigned long *);
+static int	half_text(const char * const, char * const, const int);
+static void	put_undoc(FILE * const, FILE * const, unsigned long *);
+static void	put_forms(FILE * const, FILE * const, unsigned long *,
+		    const struct form *);
+static void	put_line(FILE * const, const int, const unsigned long);
+static void	put_tree(const char * const, const int, const unsigned long);
+static FILE	*open_file(const char * const, const char * const);
+static void	usage(void)__attribute__((__noreturn__));
+
+int
+main(int argc, char *argv[])
+{
+	FILE		*fp, *bfp;
+	unsigned long	 i;
+	size_t		 m;
+	char		*ep;
+	int		 ch, mix;
+
+	while ((ch = getopt(argc, argv, "d:s:")) != -1) {
+		switch (ch) {
+		case 'd':
+			depth = (int)strtol(optarg, &ep, 0);
+			if (*ep != '\0' || depth < 0 || depth > 20)
+				errx(1, "%s: bad depth", optarg);
+			break;
+		case 's':
+			errno = 0;
+			seed = strtoull(optarg, &ep, 0);
+			if (*ep != '\0' || errno != 0)
+				errx(1, "%s: bad seed", optarg);
+			if (seed == 0)
+				seed = 1;
+			break;
+		default:
+			usage();
+			/* NOTREACHED */
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 3)
+		usage();
+	for (m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++)
+		if (strcmp(argv[0], mixes[m]) == 0)
+			break;
+	if (m == sizeof(mixes) / sizeof(mixes[0]))
+		usage();
+	mix = mixc[m];
+	fwd_flag = mix == 'l';
+	errno = 0;
+	nlines = strtoul(argv[1], &ep, 0);
+	if (*ep != '\0' || errno != 0 || nlines == 0)
+		errx(1, "%s: bad no. of lines", argv[1]);
+	dir = argv[2];
+
+	if (mix == 'i') {
+		put_tree("main", 0, nlines);
+		return (0);
+	}
+	fp = open_file("main", "asm");
+	fprintf(fp, "\torg 100h\n");
+	if (mix == 'k' || mix == 'u' || mix == 'n') {
+		bfp = open_file("expect", "bin");
+		for (i = 0; i < nlines; )
+			if (mix == 'k')
+				put_corpus(fp, bfp, &i);
+			else if (mix == 'u')
+				put_undoc(fp, bfp, &i);
+			else
+				put_forms(fp, bfp, &i, z80n);
+		if (fclose(bfp) == EOF)
+			err(1, "expect.bin");
+	} else {
+		for (i = 0; i < nlines; i++)
+			put_line(fp, (mix == 'm') ? "cdelx"[rnd() % 5] : mix,
+			    i);
+	}
+	fprintf(fp, "\tend\n");
+	if (fclose(fp) == EOF)
+		err(1, "main.asm");
+	return (0);
+}
+
+/*
+ *	next pseudo random number, xorshift64*
+ */
+static uint32_t
+rnd(void)
+{
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return ((uint32_t)((seed * 0x2545f4914f6cdd1dULL) >> 32));
+}
+
+/*
+ *	write a random instruction of mix code, the operands are
+ *	%n byte, %w word, %d displacement, %b bit, %r register, %p pair
+ */
+static void
+put_op(FILE * const fp)
+{
+	const char	*p;
+
+	for (p = ops[rnd() % (sizeof(ops) / sizeof(ops[0]))]; *p; p++) {
+		if (*p != '%') {
+			putc(*p, fp);
+			continue;
+		}
+		switch (*++p) {
+		case 'n':
+			fprintf(fp, "%u", rnd() % 256);
+			break;
+		case 'w':
+			fprintf(fp, "0%04xh", rnd() % 65536);
+			break;
+		case 'd':
+			fprintf(fp, "%u", rnd() % 128);
+			break;
+		case 'b':
+			fprintf(fp, "%u", rnd() % 8);
+			break;
+		case 'r':
+			putc("abcdehl"[rnd() % 7], fp);
+			break;
+		case 'p':
+			fputs(pairs[rnd() % 3], fp);
+			break;
+		}
+	}
+}
+
+/*
+ *	write line no. i of a mix
+ */
+static void
+put_line(FILE * const fp, const int mix, const unsigned long i)
+{
+	unsigned int	 j, n;
+	unsigned long	 nl;
+
+	switch (mix) {
+	case 'c':
+	case 'i':
+		putc('\t', fp);
+		put_op(fp);
+		break;
+	case 'd':
+		switch (rnd() % 4) {
+		case 0:
+			fprintf(fp, "\tdefw 0%04xh,0%04xh,0%04xh,0%04xh",
+			    rnd() % 65536, rnd() % 65536, rnd() % 65536,
+			    rnd() % 65536);
+			break;
+		case 1:
+			fprintf(fp, "\tdefm 'TABLE %lu'", i);
+			break;
+		default:
+			fprintf(fp, "\tdefb %u", rnd() % 256);
+			for (j = 1, n = 4 + rnd() % 12; j < n; j++)
+				fprintf(fp, ",%u", rnd() % 256);
+			break;
+		}
+		break;
+	case 'x':
+		fprintf(fp, "\tdefw ");
+		put_expr(fp, 2 + rnd() % 7);
+		break;
+	case 'e':
+		if (nequs < 16 || rnd() % 4 == 0)
+			fprintf(fp, "e%lx\tequ %u\n", nequs, rnd() % 4096);
+		else
+			fprintf(fp, "e%lx\tequ e%lx+e%lx*%u-%u\n", nequs,
+			    rnd() % nequs, rnd() % nequs, 1 + rnd() % 7,
+			    rnd() % 256);
+		nequs++;
+		return;
+	case 'l':
+		fprintf(fp, "l%lx:", nlabels++);
+		nl = fwd_flag ? nlines : nlabels;
+		switch (rnd() % 4) {
+		case 0:
+			fprintf(fp, "\tjp l%lx", rnd() % nl);
+			break;
+		case 1:
+			fprintf(fp, "\tcall l%lx", rnd() % nl);
+			break;
+		case 2:
+			fprintf(fp, "\tld hl,l%lx", rnd() % nl);
+			break;
+		default:
+			putc('\t', fp);
+			put_op(fp);
+			break;
+		}
+		break;
+	}
+	putc('\n', fp);
+}
+
+/*
+ *	write an expression of n constants or parenthesized pairs,
+ *	the expressions are evaluated from right to left and can't nest
+ *	parentheses, so a chain only ends with a division by a constant,
+ *	which is never 0
+ */
+static void
+put_expr(FILE * const fp, const int n)
+{
+	static const char	*binops[] = {
+		"+", "-", "&", "|", "^", "*", "/"
+	};
+	int			 i;
+
+	for (i = 0; i < n; i++) {
+		if (i > 0)
+			fputs(binops[rnd() % 5], fp);
+		if (rnd() % 3 == 0)
+			fprintf(fp, "(%u%s%u)", rnd() % 256, binops[rnd() % 7],
+			    1 + rnd() % 255);
+		else
+			fprintf(fp, "%u", rnd() % 256);
+	}
+	if (rnd() % 2 == 0)
+		fprintf(fp, "/%u", 1 + rnd() % 255);
+}
+
+/*
+ *	decode an unprefixed opcode into an instruction, n is 12h,
+ *	nn 3456h and the displacement of relative jumps 5
+ *
+ *	Output: kind of the operand: 0 none, 'n', 'w', 'e', or
+ *		-1 for the prefixes CB, DD, ED and FD
+ */
+static int
+dis_base(const int op, char * const s)
+{
+	const int	x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	const int	p = y >> 1, q = y & 1;
+
+	switch (x) {
+	case 0:
+		switch (z) {
+		case 0:
+			if (y < 2) {
+				strcpy(s, y ? "EX AF,AF'" : "NOP");
+				return (0);
+			}
+			if (y < 4)
+				strcpy(s, (y == 2) ? "DJNZ $+7" : "JR $+7");
+			else
+				sprintf(s, "JR %s,$+7", conds[y - 4]);
+			return ('e');
+		case 1:
+			if (q)
+				sprintf(s, "ADD HL,%s", rps[p]);
+			else
+				sprintf(s, "LD %s,3456H", rps[p]);
+			return (q ? 0 : 'w');
+		case 2:
+			if (p < 2) {
+				sprintf(s, q ? "LD A,(%s)" : "LD (%s),A",
+				    rps[p]);
+				return (0);
+			}
+			sprintf(s, q ? "LD %s,(3456H)" : "LD (3456H),%s",
+			    (p == 2) ? "HL" : "A");
+			return ('w');
+		case 3:
+			sprintf(s, "%s %s", q ? "DEC" : "INC", rps[p]);
+			return (0);
+		case 4:
+		case 5:
+			sprintf(s, "%s %s", (z == 4) ? "INC" : "DEC", regs[y]);
+			return (0);
+		case 6:
+			sprintf(s, "LD %s,12H", regs[y]);
+			return ('n');
+		default:
+			strcpy(s, accs[y]);
+			return (0);
+		}
+	case 1:
+		if (y == 6 && z == 6)
+			strcpy(s, "HALT");
+		else
+			sprintf(s, "LD %s,%s", regs[y], regs[z]);
+		return (0);
+	case 2:
+		sprintf(s, "%s%s", alus[y], regs[z]);
+		return (0);
+	}
+	switch (z) {
+	case 0:
+		sprintf(s, "RET %s", conds[y]);
+		return (0);
+	case 1:
+		if (q)
+			strcpy(s, xtra[p]);
+		else
+			sprintf(s, "POP %s", rps2[p]);
+		return (0);
+	case 2:
+		sprintf(s, "JP %s,3456H", conds[y]);
+		return ('w');
+	case 3:
+		switch (y) {
+		case 0:
+			strcpy(s, "JP 3456H");
+			return ('w');
+		case 1:
+			return (-1);
+		case 2:
+		case 3:
+			strcpy(s, (y == 2) ? "OUT (12H),A" : "IN A,(12H)");
+			return ('n');
+		default:
+			strcpy(s, xtra[y]);
+			return (0);
+		}
+	case 4:
+		sprintf(s, "CALL %s,3456H", conds[y]);
+		return ('w');
+	case 5:
+		if (!q) {
+			sprintf(s, "PUSH %s", rps2[p]);
+			return (0);
+		}
+		if (p != 0)
+			return (-1);
+		strcpy(s, "CALL 3456H");
+		return ('w');
+	case 6:
+		sprintf(s, "%s12H", alus[y]);
+		return ('n');
+	default:
+		sprintf(s, "RST %02XH", y * 8);
+		return (0);
+	}
+}
+
+/*
+ *	write an instruction and its expected bytes
+ */
+static void
+put_ins(FILE * const fp, FILE * const bfp, const char * const s,
+    const uint8_t * const b, const int n)
+{
+	fprintf(fp, "\t%s\n", s);
+	if (fwrite(b, 1, (size_t)n, bfp) != (size_t)n)
+		err(1, "expect.bin");
+}
+
+/*
+ *	write every documented instruction form once, the index register
+ *	forms are derived from the forms with HL and (HL)
+ *
+ *	Input: files of source and bytes, counter of lines
+ */
+static void
+put_corpus(FILE * const fp, FILE * const bfp, unsigned long *i)
+{
+	static const uint8_t	 imm[4][3] = {	/* bytes of the operands */
+		{ 0 }, { 0x12 }, { 0x56, 0x34 }, { 0x05 }
+	};
+	static const int	 ims[8] = { 0, -1, 1, 2, -1, -1, -1, -1 };
+	char			 s[32], t[40], *h;
+	uint8_t			 b[8];
+	int			 op, k, n, x, y, z, j;
+
+	for (op = 0; op < 256 && *i < nlines; op++) {
+		if ((k = dis_base(op, s)) < 0)
+			continue;
+		n = (k == 'n' || k == 'e') ? 1 : (k == 'w') ? 2 : 0;
+		j = (k == 'n') ? 1 : (k == 'w') ? 2 : (k == 'e') ? 3 : 0;
+		b[0] = (uint8_t)op;
+		memcpy(b + 1, imm[j], (size_t)n);
+		put_ins(fp, bfp, s, b, 1 + n);
+		(*i)++;
+		for (x = 0; x < 2; x++) {	/* IX and IY */
+			b[0] = x ? 0xfd : 0xdd;
+			b[1] = (uint8_t)op;
+			if (op == 0xe9) {
+				strcpy(t, x ? "JP (IY)" : "JP (IX)");
+				put_ins(fp, bfp, t, b, 2);
+			} else if ((h = strstr(s, "(HL)")) != NULL) {
+				if (op == 0x76)
+					continue;
+				snprintf(t, sizeof(t), "%.*s(%s+5)%s",
+				    (int)(h - s), s, x ? "IY" : "IX", h + 4);
+				b[2] = 0x05;
+				memcpy(b + 3, imm[j], (size_t)n);
+				put_ins(fp, bfp, t, b, 3 + n);
+			} else if ((h = strstr(s, "HL")) != NULL &&
+			    op != 0xeb) {
+				strcpy(t, s);
+				while ((h = strstr(t, "HL")) != NULL)
+					memcpy(h, x ? "IY" : "IX", 2);
+				memcpy(b + 2, imm[j], (size_t)n);
+				put_ins(fp, bfp, t, b, 2 + n);
+			} else
+				continue;
+			(*i)++;
+		}
+	}
+	for (op = 0; op < 256 && *i < nlines; op++) {	/* CB */
+		x = op >> 6;
+		y = (op >> 3) & 7;
+		z = op & 7;
+		if (x == 0 && rots[y] == NULL)
+			continue;
+		if (x == 0)
+			sprintf(s, "%s ", rots[y]);
+		else
+			sprintf(s, "%s %d,", bits[x], y);
+		snprintf(t, sizeof(t), "%s%s", s, regs[z]);
+		b[0] = 0xcb;
+		b[1] = (uint8_t)op;
+		put_ins(fp, bfp, t, b, 2);
+		(*i)++;
+		if (z != 6)
+			continue;
+		for (j = 0; j < 2; j++) {	/* DDCB and FDCB */
+			snprintf(t, sizeof(t), "%s%s", s,
+			    j ? "(IY+5)" : "(IX+5)");
+			b[0] = j ? 0xfd : 0xdd;
+			b[1] = 0xcb;
+			b[2] = 0x05;
+			b[3] = (uint8_t)op;
+			put_ins(fp, bfp, t, b, 4);
+			(*i)++;
+		}
+	}
+	for (op = 0x40; op < 0xc0 && *i < nlines; op++) {	/* ED */
+		y = (op >> 3) & 7;
+		z = op & 7;
+		n = 0;
+		if (op >= 0x80) {
+			if (y < 4 || z > 3)
+				continue;
+			strcpy(t, blks[y - 4][z]);
+		} else {
+			switch (z) {
+			case 0:
+			case 1:
+				if (y == 6)
+					continue;
+				sprintf(t, z ? "OUT (C),%s" : "IN %s,(C)",
+				    regs[y]);
+				break;
+			case 2:
+				sprintf(t, "%s HL,%s", (y & 1) ? "ADC" : "SBC",
+				    rps[y >> 1]);
+				break;
+			case 3:
+				if (y >> 1 == 2)	/* HL is shorter */
+					continue;
+				sprintf(t, (y & 1) ? "LD %s,(3456H)" :
+				    "LD (3456H),%s", rps[y >> 1]);
+				n = 2;
+				break;
+			case 4:
+			case 5:
+				if (y > 1 || (z == 4 && y != 0))
+					continue;
+				strcpy(t, (z == 4) ? "NEG" :
+				    y ? "RETI" : "RETN");
+				break;
+			case 6:
+				if (ims[y] < 0)
+					continue;
+				sprintf(t, "IM %d", ims[y]);
+				break;
+			default:
+				if (y > 5)
+					continue;
+				strcpy(t, eds[y]);
+				break;
+			}
+		}
+		b[0] = 0xed;
+		b[1] = (uint8_t)op;
+		memcpy(b + 2, imm[2], (size_t)n);
+		put_ins(fp, bfp, t, b, 2 + n);
+		(*i)++;
+	}
+}
+
+/*
+ *	replace the operands H and L of an instruction by the halves
+ *	of IX, or of IY for x 1
+ *
+ *	Output: no. of operands replaced
+ */
+static int
+half_text(const char * const s, char * const t, const int x)
+{
+	const char	*p, *e;
+	char		*q;
+	int		 n;
+
+	if ((p = strchr(s, ' ')) == NULL)
+		return (0);
+	memcpy(t, s, (size_t)(++p - s));
+	q = t + (p - s);
+	for (n = 0; ; p = e + 1) {
+		if ((e = strchr(p, ',')) == NULL)
+			e = p + strlen(p);
+		if (e - p == 1 && (*p == 'H' || *p == 'L')) {
+			q += sprintf(q, "I%c%c", x ? 'Y' : 'X', *p);
+			n++;
+		} else {
+			memcpy(q, p, (size_t)(e - p));
+			q += e - p;
+		}
+		if (*e == '\0')
+			break;
+		*q++ = ',';
+	}
+	*q = '\0';
+	return (n);
+}
+
+/*
+ *	write every undocumented instruction form of -U once:
+ *	the halves of the index registers, SLL, the copy of the
+ *	result to a register with (IX+d) and (IY+d), IN F,(C),
+ *	IN (C) and OUT (C),0
+ *
+ *	Input: files of source and bytes, counter of lines
+ */
+static void
+put_undoc(FILE * const fp, FILE * const bfp, unsigned long *i)
+{
+	static const struct form	 io[] = {
+		{ "IN F,(C)",	2, { 0xed, 0x70 } },
+		{ "IN (C)",	2, { 0xed, 0x70 } },
+		{ "OUT (C),0",	2, { 0xed, 0x71 } },
+		{ NULL,		0, { 0 } }
+	};
+	char				 s[32], t[32];
+	uint8_t				 b[8];
+	int				 op, k, x, y, z, j;
+
+	for (op = 0; op < 256 && *i < nlines; op++) {
+		if ((k = dis_base(op, s)) < 0 || strstr(s, "HL") != NULL)
+			continue;
+		for (x = 0; x < 2 && *i < nlines; x++) {
+			if (half_text(s, t, x) == 0)
+				break;
+			b[0] = x ? 0xfd : 0xdd;
+			b[1] = (uint8_t)op;
+			b[2] = 0x12;		/* n of LD r,n */
+			put_ins(fp, bfp, t, b, (k == 'n') ? 3 : 2);
+			(*i)++;
+		}
+	}
+	for (op = 0; op < 256 && *i < nlines; op++) {	/* CB */
+		x = op >> 6;
+		y = (op >> 3) & 7;
+		z = op & 7;
+		if (x == 1 || (x == 0 && y != 6 && z != 6))
+			continue;
+		if (x == 0 && y == 6) {		/* SLL */
+			snprintf(t, sizeof(t), "SLL %s", regs[z]);
+			b[0] = 0xcb;
+			b[1] = (uint8_t)op;
+			put_ins(fp, bfp, t, b, 2);
+			(*i)++;
+		}
+		if (z == 6 && y != 6)
+			continue;
+		for (j = 0; j < 2; j++) {	/* DDCB and FDCB */
+			if (x == 0)
+				snprintf(t, sizeof(t), "%s (I%c+5)",
+				    (y == 6) ? "SLL" : rots[y], j ? 'Y' : 'X');
+			else
+				snprintf(t, sizeof(t), "%s %d,(I%c+5)",
+				    bits[x], y, j ? 'Y' : 'X');
+			if (z != 6)
+				snprintf(t + strlen(t), sizeof(t) - strlen(t),
+				    ",%s", regs[z]);
+			b[0] = j ? 0xfd : 0xdd;
+			b[1] = 0xcb;
+			b[2] = 0x05;
+			b[3] = (uint8_t)op;
+			put_ins(fp, bfp, t, b, 4);
+			(*i)++;
+		}
+	}
+	put_forms(fp, bfp, i, io);
+}
+
+/*
+ *	write the instruction forms of a table once
+ *
+ *	Input: files of source and bytes, counter of lines, table
+ */
+static void
+put_forms(FILE * const fp, FILE * const bfp, unsigned long *i,
+    const struct form *tp)
+{
+	for (; tp->f_text != NULL && *i < nlines; tp++, (*i)++)
+		put_ins(fp, bfp, tp->f_text, tp->f_bytes, tp->f_len);
+}
+
+/*
+ *	write a file of the INCLUDE tree, the inner files split their
+ *	lines between two included files and a few lines of their own
+ *
+ *	Input: name of the file, its depth, no. of lines below it
+ */
+static void
+put_tree(const char * const name, const int d, const unsigned long n)
+{
+	FILE		*fp;
+	unsigned long	 i, own;
+	char		 sub[PATH_MAX];
+
+	fp = open_file(name, "asm");
+	if (d == 0)
+		fprintf(fp, "\torg 100h\n");
+	if (d == depth || n < 8) {
+		for (i = 0; i < n; i++)
+			put_line(fp, 'i', i);
+	} else {
+		own = n / 8;
+		for (i = 0; i < own; i++)
+			put_line(fp, 'i', i);
+		snprintf(sub, sizeof(sub), "%s0", (d == 0) ? "i" : name);
+		fprintf(fp, "\tinclude %s.asm\n", sub);
+		put_tree(sub, d + 1, (n - own) / 2);
+		snprintf(sub, sizeof(sub), "%s1", (d == 0) ? "i" : name);
+		fprintf(fp, "\tinclude %s.asm\n", sub);
+		put_tree(sub, d + 1, n - own - (n - own) / 2);
+	}
+	if (d == 0)
+		fprintf(fp, "\tend\n");
+	if (fclose(fp) == EOF)
+		err(1, "%s.asm", name);
+}
+
+/*
+ *	create a file in the output directory
+ */
+static FILE *
+open_file(const char * const name, const char * const ext)
+{
+	FILE	*fp;
+	char	 fn[PATH_MAX];
+
+	snprintf(fn, sizeof(fn), "%s/%s.%s", dir, name, ext);
+	if ((fp = fopen(fn, "w")) == NULL)
+		err(1, "%s", fn);
+	return (fp);
+}
+
+/*
+ *	error in options, print usage
+ */
+static void
+usage(void)
+{
+	(void)fprintf(stderr, "usage: %s [-d depth] [-s seed] "
+	    "code|defb|equ|include|label|expr|mixed|corpus|corpus-u|"
+	    "corpus-n lines directory\n", __progname);
+	exit(1);
+}
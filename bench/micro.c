@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	micro benchmark of the kernels of the assembler
+ *	calls search_op(), get_reg(), put_sym(), get_sym(), eval(),
+ *	obj_writeb() into Intel hex, which flushes a record with
+ *	flush_hex() every 16 bytes, and lst_line() in loops and prints
+ *	the nanoseconds per call of the fastest of some runs
+ *	the object and the listing are written to /dev/null, so the
+ *	times include the buffered stdio but no I/O to a disk
+ *	zz80asm.c is compiled in for the globals, its main() renamed,
+ *	the other modules are linked from the objects of the assembler
+ */
+
+#include <time.h>
+
+int	asm_main(int, char *[]);	/* main() of the assembler, unused */
+
+#define main	asm_main
+#include "../zz80asm.c"
+#undef main
+
+static void	micro_usage(void)__attribute__((__noreturn__));
+static double	now(void);
+static void	run(const char * const, void (*)(void));
+static void	k_search(void);
+static void	k_getreg(void);
+static void	k_putsym(void);
+static void	k_getsym(void);
+static void	k_eval(void);
+static void	k_hex(void);
+static void	k_list(void);
+
+static const char *mnems[] = {		/* opcodes for search_op() */
+	"LD", "ADD", "JP", "CALL", "PUSH", "POP", "INC", "DEC", "DJNZ",
+	"JR", "EX", "LDIR", "OUT", "IN", "RET", "XOR", "DEFB", "EQU",
+	"NOSUCH", NULL
+};
+static const char *opers[] = {		/* operands for get_reg() */
+	"A", "B", "HL", "(HL)", "DE", "IX", "(C)", "NZ", "SP", "AF'",
+	"1234H", NULL
+};
+static const char *exprs[] = {		/* expressions for eval() */
+	"1234H", "S0001+2", "S0005*4-S0002", "0FFH&S0003|80H",
+	"S0004+10/2", "'A'+1", NULL
+};
+
+static unsigned long	 loops = 1000000;	/* calls per run */
+static int		 runs = 3;		/* runs of each kernel */
+static unsigned long	 nsyms = 1000;		/* symbols of the table */
+static char		(*syms)[24];		/* names of the symbols */
+
+int
+main(int argc, char *argv[])
+{
+	int		 ch;
+	unsigned long	 i;
+	char		*ep;
+
+	while ((ch = getopt(argc, argv, "n:r:s:")) != -1) {
+		errno = 0;
+		switch (ch) {
+		case 'n':
+			loops = strtoul(optarg, &ep, 0);
+			break;
+		case 'r':
+			runs = (int)strtol(optarg, &ep, 0);
+			break;
+		case 's':
+			nsyms = strtoul(optarg, &ep, 0);
+			break;
+		default:
+			micro_usage();
+			/* NOTREACHED */
+		}
+		if (*ep != '\0' || errno != 0 || *optarg == '-')
+			micro_usage();
+	}
+	if (optind != argc || loops == 0 || runs < 1 || nsyms < 10 ||
+	    nsyms > 99999)
+		micro_usage();
+
+	gencode = 1;
+	pass = 1;
+	errfp = stderr;
+	datalen = 16;
+	out_form = OUTHEX;
+	if ((objfp = fopen("/dev/null", "w")) == NULL ||
+	    (lstfp = fopen("/dev/null", "w")) == NULL)
+		err(1, "/dev/null");
+	if ((syms = calloc(2 * nsyms, sizeof(*syms))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < 2 * nsyms; i++)		/* T... are undefined */
+		snprintf(syms[i], sizeof(syms[i]), "%c%04lu",
+		    (i < nsyms) ? 'S' : 'T', i % nsyms);
+
+	printf("%-12s %12s %10s\n", "kernel", "calls", "ns/call");
+	run("search_op", k_search);
+	run("get_reg", k_getreg);
+	run("put_sym", k_putsym);
+	run("get_sym", k_getsym);
+	run("eval", k_eval);
+	run("flush_hex", k_hex);
+	run("lst_line", k_list);
+	if (errors)
+		errx(1, "%d errors", errors);
+	return (0);
+}
+
+/*
+ *	seconds of the monotonic clock
+ */
+static double
+now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double)ts.tv_sec + (double)ts.tv_nsec / 1e9);
+}
+
+/*
+ *	run a kernel, loops calls at a time, and print the time
+ *	per call of the fastest run
+ */
+static void
+run(const char * const name, void (*kernel)(void))
+{
+	int	i;
+	double	t, best;
+
+	best = 0;
+	for (i = 0; i < runs; i++) {
+		t = now();
+		(*kernel)();
+		t = now() - t;
+		if (i == 0 || t < best)
+			best = t;
+	}
+	printf("%-12s %12lu %10.1f\n", name, loops, best * 1e9 / loops);
+}
+
+/*
+ *	look up the opcodes in turn
+ */
+static void
+k_search(void)
+{
+	unsigned long	i;
+	const char	**p;
+
+	for (i = 0, p = mnems; i < loops; i++) {
+		search_op(*p);
+		if (*++p == NULL)
+			p = mnems;
+	}
+}
+
+/*
+ *	look up the operands in turn
+ */
+static void
+k_getreg(void)
+{
+	unsigned long	i;
+	const char	**p;
+
+	for (i = 0, p = opers; i < loops; i++) {
+		get_reg(*p);
+		if (*++p == NULL)
+			p = opers;
+	}
+}
+
+/*
+ *	define the symbols S0000 up to nsyms, the first run adds them
+ *	to the table, the others modify them
+ */
+static void
+k_putsym(void)
+{
+	unsigned long	i;
+
+	for (i = 0; i < loops; i++)
+		if (put_sym(syms[i % nsyms], (int)i))
+			fatal(F_OUTMEM, "symbols");
+}
+
+/*
+ *	look up the symbols, one in ten is undefined
+ */
+static void
+k_getsym(void)
+{
+	unsigned long	i;
+
+	for (i = 0; i < loops; i++)
+		get_sym(syms[i % nsyms + ((i % 10 == 9) ? nsyms : 0)]);
+}
+
+/*
+ *	evaluate the expressions in turn
+ */
+static void
+k_eval(void)
+{
+	unsigned long	i;
+	const char	**p;
+
+	for (i = 0, p = exprs; i < loops; i++) {
+		eval(*p);
+		if (*++p == NULL)
+			p = exprs;
+	}
+}
+
+/*
+ *	write 4 bytes at a time into the Intel hex object
+ */
+static void
+k_hex(void)
+{
+	unsigned long	i;
+
+	ops[0] = 0xdd;
+	ops[1] = 0x21;
+	ops[2] = 0x34;
+	ops[3] = 0x12;
+	for (i = 0; i < loops; i++)
+		obj_writeb(4);
+}
+
+/*
+ *	list a line of 3 bytes
+ */
+static void
+k_list(void)
+{
+	unsigned long	i;
+
+	list_flag = 1;
+	ppl = 0;
+	c_line = 2;
+	strlcpy(line, "\tLD\tBC,1234H\n", sizeof(line));
+	ops[0] = 0x01;
+	ops[1] = 0x34;
+	ops[2] = 0x12;
+	for (i = 0; i < loops; i++) {
+		s_line++;
+		lst_line((int)i, 3);
+	}
+}
+
+/*
+ *	print usage and exit
+ */
+static void
+micro_usage(void)
+{
+	fprintf(stderr, "usage: %s [-n loops] [-r runs] [-s symbols]\n",
+	    __progname);
+	exit(1);
+}
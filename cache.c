@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the build cache
+ *	the output of a run is stored in the cache directory under a key built
+ *	from the release, the cache format, the options and the input files;
+ *	a manifest records
+ *	the contents hash of every source file read, so a later run with
+ *	unchanged sources copies the output instead of assembling it
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "zz80asm.h"
+
+#define FNVBASIS	0xcbf29ce484222325ULL	/* FNV-1a offset basis */
+#define FNVPRIME	0x100000001b3ULL	/* FNV-1a prime */
+#define CACHEVER	2			/* version of cache format */
+
+/*
+ *	structure cache entries for eviction
+ */
+struct centry {
+	char	ce_key[17];	/* key as hex string */
+	time_t	ce_time;	/* time of last use */
+	off_t	ce_size;	/* size of all files of entry */
+};
+
+static void	cache_path(char * const, const char * const, const uint64_t,
+		    const char * const);
+static int	copy_file(const char * const, const char * const);
+static off_t	file_size(const char * const);
+static void	cache_count(const char * const, const int);
+static void	cache_evict(const char * const, const off_t);
+static int	cecmp(const void *, const void *);
+
+/*
+ *	FNV-1a hash over a buffer
+ *
+ *	Input: hash value to continue, pointer and length of buffer
+ *
+ *	Output: hash value
+ */
+uint64_t
+fnv_hash(uint64_t h, const void * const buf, const size_t len)
+{
+	const unsigned char	*p;
+	size_t			 i;
+
+	if (h == 0)
+		h = FNVBASIS;
+	for (p = buf, i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= FNVPRIME;
+	}
+	return (h);
+}
+
+/*
+ *	compute the key for a run from release, cache format, options and
+ *	input files
+ *
+ *	Input: NULL terminated list of input files
+ *	       flag for option -s
+ *	       symbol definitions of options -D and -V, or NULL
+ *
+ *	Output: key
+ */
+uint64_t
+cache_key(char ** const files, const int sym_flag, const char * const defs)
+{
+	char		 opts[64];
+	char		**fp;
+	uint64_t	 h, fh;
+
+	h = fnv_hash(0, REL, sizeof(REL));
+	snprintf(opts, sizeof(opts), "%d %d %zu %d %d %d %d %d %d %d %d %d",
+	    CACHEVER, out_form, datalen, dump_flag, list_flag, sym_flag,
+	    pack_flag, cyc_flag, relax_flag, opt_flag, undoc_flag, cpu_type);
+	h = fnv_hash(h, opts, strlen(opts) + 1);
+	if (defs != NULL)
+		h = fnv_hash(h, defs, strlen(defs) + 1);
+	for (fp = files; *fp != NULL; fp++) {
+		fh = src_hash(*fp);
+		h = fnv_hash(h, *fp, strlen(*fp) + 1);
+		h = fnv_hash(h, &fh, sizeof(fh));
+	}
+	return (h);
+}
+
+/*
+ *	look up a run in the cache, on a hit the cached output is copied
+ *	to the object and listing file
+ *
+ *	Input: cache directory, key, object and listing filename
+ *
+ *	Output: 1 hit, output files written
+ *		0 miss
+ */
+int
+cache_get(const char * const dir, const uint64_t key, const char * const obj,
+    const char * const lst)
+{
+	FILE		*fp;
+	char		 path[PATH_MAX], fn[PATH_MAX];
+	uint64_t	 h;
+	int		 hit;
+
+	cache_path(path, dir, key, ".m");
+	if ((fp = fopen(path, "r")) == NULL) {
+		cache_count(dir, 0);
+		return (0);
+	}
+	hit = 1;
+	if (fscanf(fp, "zz80asm %" SCNx64 "\n", &h) != 1 || h != key)
+		hit = 0;
+	while (hit && fscanf(fp, "%" SCNx64 " %1023[^\n]\n", &h, fn) == 2)
+		if (access(fn, R_OK) == -1 || src_hash(fn) != h)
+			hit = 0;
+	if (hit && !feof(fp))
+		hit = 0;
+	fclose(fp);
+	if (hit) {
+		cache_path(path, dir, key, ".o");
+		if (copy_file(path, obj) == -1)
+			hit = 0;
+	}
+	if (hit && list_flag) {
+		cache_path(path, dir, key, ".l");
+		if (copy_file(path, lst) == -1)
+			hit = 0;
+	}
+	if (hit) {
+		cache_path(path, dir, key, ".m");
+		utimes(path, NULL);	/* mark as recently used */
+		if ((fp = fopen(path, "r")) != NULL) {
+			fscanf(fp, "zz80asm %" SCNx64 "\n", &h);
+			while (fscanf(fp, "%" SCNx64 " %1023[^\n]\n", &h,
+			    fn) == 2)
+				src_mark(fn);
+			fclose(fp);
+		}
+	}
+	cache_count(dir, hit);
+	return (hit);
+}
+
+/*
+ *	store the output of a run in the cache
+ *
+ *	Input: cache directory, key, object and listing filename,
+ *	       max. size of the cache in kilobytes
+ */
+void
+cache_put(const char * const dir, const uint64_t key, const char * const obj,
+    const char * const lst, const size_t max)
+{
+	FILE	*fp;
+	char	 path[PATH_MAX], tmpfn[PATH_MAX];
+
+	cache_path(path, dir, key, ".o");
+	if (copy_file(obj, path) == -1)
+		return;
+	if (list_flag) {
+		cache_path(path, dir, key, ".l");
+		if (copy_file(lst, path) == -1)
+			return;
+	}
+	/* the manifest is written last, it validates the entry */
+	cache_path(path, dir, key, ".m");
+	if (snprintf(tmpfn, sizeof(tmpfn), "%s.%ld", path,
+	    (long)getpid()) >= (int)sizeof(tmpfn))
+		return;
+	if ((fp = fopen(tmpfn, "w")) == NULL)
+		return;
+	fprintf(fp, "zz80asm %016" PRIx64 "\n", key);
+	src_list(fp);
+	if (fclose(fp) == EOF || rename(tmpfn, path) == -1) {
+		unlink(tmpfn);
+		return;
+	}
+	cache_evict(dir, (off_t)max * 1024);
+}
+
+/*
+ *	print statistics of the cache
+ *
+ *	Input: cache directory, max. size of the cache in kilobytes
+ */
+void
+cache_stats(const char * const dir, const size_t max)
+{
+	FILE		*fp;
+	DIR		*dp;
+	struct dirent	*de;
+	char		 path[PATH_MAX];
+	size_t		 n, len;
+	unsigned long	 hits, misses;
+	off_t		 size;
+
+	hits = misses = 0;
+	snprintf(path, sizeof(path), "%s/stats", dir);
+	if ((fp = fopen(path, "r")) != NULL) {
+		if (fscanf(fp, "%lu %lu", &hits, &misses) != 2)
+			hits = misses = 0;
+		fclose(fp);
+	}
+	n = 0;
+	size = 0;
+	if ((dp = opendir(dir)) != NULL) {
+		while ((de = readdir(dp)) != NULL) {
+			len = strlen(de->d_name);
+			if (len != 18 || de->d_name[16] != '.')
+				continue;
+			snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+			size += file_size(path);
+			if (de->d_name[17] == 'm')
+				n++;
+		}
+		closedir(dp);
+	}
+	fprintf(stdout, "Cache directory: %s\n", dir);
+	fprintf(stdout, "Cache hits:      %lu\n", hits);
+	fprintf(stdout, "Cache misses:    %lu\n", misses);
+	if (hits + misses)
+		fprintf(stdout, "Hit rate:        %lu%%\n",
+		    hits * 100 / (hits + misses));
+	fprintf(stdout, "Entries:         %zu\n", n);
+	fprintf(stdout, "Size:            %lld KB of %zu KB\n",
+	    (long long)(size / 1024), max);
+}
+
+/*
+ *	build path of a file of a cache entry
+ */
+static void
+cache_path(char * const path, const char * const dir, const uint64_t key,
+    const char * const ext)
+{
+	snprintf(path, PATH_MAX, "%s/%016" PRIx64 "%s", dir, key, ext);
+}
+
+/*
+ *	copy file "from" to file "to"
+ *
+ *	Output: 0 file copied
+ *		-1 error
+ */
+static int
+copy_file(const char * const from, const char * const to)
+{
+	FILE	*in, *out;
+	char	 buf[BUFSIZ];
+	size_t	 n;
+	int	 ret;
+
+	if ((in = fopen(from, "r")) == NULL)
+		return (-1);
+	if ((out = fopen(to, "w")) == NULL) {
+		fclose(in);
+		return (-1);
+	}
+	ret = 0;
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		if (fwrite(buf, 1, n, out) != n) {
+			ret = -1;
+			break;
+		}
+	if (ferror(in))
+		ret = -1;
+	fclose(in);
+	if (fclose(out) == EOF)
+		ret = -1;
+	return (ret);
+}
+
+/*
+ *	size of a file, 0 if it doesn't exist
+ */
+static off_t
+file_size(const char * const fn)
+{
+	struct stat	st;
+
+	if (stat(fn, &st) == -1)
+		return (0);
+	return (st.st_size);
+}
+
+/*
+ *	count a hit or miss in the statistics of the cache
+ */
+static void
+cache_count(const char * const dir, const int hit)
+{
+	FILE		*fp;
+	char		 path[PATH_MAX];
+	unsigned long	 hits, misses;
+
+	hits = misses = 0;
+	snprintf(path, sizeof(path), "%s/stats", dir);
+	if ((fp = fopen(path, "r")) != NULL) {
+		if (fscanf(fp, "%lu %lu", &hits, &misses) != 2)
+			hits = misses = 0;
+		fclose(fp);
+	}
+	if (hit)
+		hits++;
+	else
+		misses++;
+	if ((fp = fopen(path, "w")) != NULL) {
+		fprintf(fp, "%lu %lu\n", hits, misses);
+		fclose(fp);
+	}
+}
+
+/*
+ *	remove least recently used entries until the cache
+ *	is not larger than max bytes
+ */
+static void
+cache_evict(const char * const dir, const off_t max)
+{
+	DIR		*dp;
+	struct dirent	*de;
+	struct stat	 st;
+	struct centry	*ce, *newce;
+	size_t		 n, size, i;
+	off_t		 total;
+	char		 path[PATH_MAX];
+
+	if ((dp = opendir(dir)) == NULL)
+		return;
+	ce = NULL;
+	n = size = 0;
+	total = 0;
+	while ((de = readdir(dp)) != NULL) {
+		if (strlen(de->d_name) != 18 || strcmp(de->d_name + 16, ".m"))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		if (stat(path, &st) == -1)
+			continue;
+		if (n == size) {
+			size += SYMINC;
+			newce = realloc(ce, size * sizeof(struct centry));
+			if (newce == NULL)
+				fatal(F_OUTMEM, "cache eviction");
+			ce = newce;
+		}
+		strlcpy(ce[n].ce_key, de->d_name, sizeof(ce[n].ce_key));
+		ce[n].ce_time = st.st_mtime;
+		ce[n].ce_size = st.st_size;
+		snprintf(path, sizeof(path), "%s/%s.o", dir, ce[n].ce_key);
+		ce[n].ce_size += file_size(path);
+		snprintf(path, sizeof(path), "%s/%s.l", dir, ce[n].ce_key);
+		ce[n].ce_size += file_size(path);
+		total += ce[n].ce_size;
+		n++;
+	}
+	closedir(dp);
+	if (total > max) {
+		qsort(ce, n, sizeof(struct centry), cecmp);
+		for (i = 0; i < n && total > max; i++) {
+			snprintf(path, sizeof(path), "%s/%s.m", dir,
+			    ce[i].ce_key);
+			unlink(path);
+			snprintf(path, sizeof(path), "%s/%s.o", dir,
+			    ce[i].ce_key);
+			unlink(path);
+			snprintf(path, sizeof(path), "%s/%s.l", dir,
+			    ce[i].ce_key);
+			unlink(path);
+			total -= ce[i].ce_size;
+		}
+	}
+	free(ce);
+}
+
+/*
+ *	compare cache entries by time of last use, result like strcmp()
+ */
+static int
+cecmp(const void *p1, const void *p2)
+{
+	const struct centry	*c1 = p1, *c2 = p2;
+
+	if (c1->ce_time < c2->ce_time)
+		return (-1);
+	else if (c1->ce_time > c2->ce_time)
+		return (1);
+	else
+		return (0);
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the T-states of the encoded instructions
+ *	the cycles are looked up from the bytes in ops[], conditional
+ *	instructions have two counts: taken and not taken
+ *	the T-states of all instructions are kept in pass 2, to check
+ *	the budgets of CYCLES at the end of pass 2
+ *	with -c z180 the T-states of the Z180 are used, with -c z80n
+ *	those of the opcodes added by the Z80N
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zz80asm.h"
+
+static const unsigned char cyc_main[256] = {	/* unprefixed, taken */
+/*	 0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */	 4, 10,  7,  6,  4,  4,  7,  4,  4, 11,  7,  6,  4,  4,  7,  4,
+/* 1 */	13, 10,  7,  6,  4,  4,  7,  4, 12, 11,  7,  6,  4,  4,  7,  4,
+/* 2 */	12, 10, 16,  6,  4,  4,  7,  4, 12, 11, 16,  6,  4,  4,  7,  4,
+/* 3 */	12, 10, 13,  6, 11, 11, 10,  4, 12, 11, 13,  6,  4,  4,  7,  4,
+/* 4 */	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+/* 5 */	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+/* 6 */	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+/* 7 */	 7,  7,  7,  7,  7,  7,  4,  7,  4,  4,  4,  4,  4,  4,  7,  4,
+/* 8 */	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+/* 9 */	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+/* A */	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+/* B */	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+/* C */	11, 10, 10, 10, 17, 11,  7, 11, 11, 10, 10,  0, 17, 17,  7, 11,
+/* D */	11, 10, 10, 11, 17, 11,  7, 11, 11,  4, 10, 11, 17,  0,  7, 11,
+/* E */	11, 10, 10, 19, 17, 11,  7, 11, 11,  4, 10,  4, 17,  0,  7, 11,
+/* F */	11, 10, 10,  4, 17, 11,  7, 11, 11,  6, 10,  4, 17,  0,  7, 11
+};
+
+static const unsigned char cyc_ed[64] = {	/* ED 40 - ED 7F */
+/*	 0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 4 */	12, 12, 15, 20,  8, 14,  8,  9, 12, 12, 15, 20,  8, 14,  8,  9,
+/* 5 */	12, 12, 15, 20,  8, 14,  8,  9, 12, 12, 15, 20,  8, 14,  8,  9,
+/* 6 */	12, 12, 15, 20,  8, 14,  8, 18, 12, 12, 15, 20,  8, 14,  8, 18,
+/* 7 */	12, 12, 15, 20,  8, 14,  8,  8, 12, 12, 15, 20,  8, 14,  8,  8
+};
+
+static const unsigned char cyc_m180[256] = {	/* Z180 unprefixed, taken */
+/*	 0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */	 3,  9,  7,  4,  4,  4,  6,  3,  4,  7,  6,  4,  4,  4,  6,  3,
+/* 1 */	 9,  9,  7,  4,  4,  4,  6,  3,  8,  7,  6,  4,  4,  4,  6,  3,
+/* 2 */	 8,  9, 16,  4,  4,  4,  6,  4,  8,  7, 15,  4,  4,  4,  6,  3,
+/* 3 */	 8,  9, 13,  4, 10, 10,  9,  3,  8,  7, 12,  4,  4,  4,  6,  3,
+/* 4 */	 4,  4,  4,  4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  6,  4,
+/* 5 */	 4,  4,  4,  4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  6,  4,
+/* 6 */	 4,  4,  4,  4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  6,  4,
+/* 7 */	 7,  7,  7,  7,  7,  7,  3,  7,  4,  4,  4,  4,  4,  4,  6,  4,
+/* 8 */	 4,  4,  4,  4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  6,  4,
+/* 9 */	 4,  4,  4,  4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  6,  4,
+/* A */	 4,  4,  4,  4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  6,  4,
+/* B */	 4,  4,  4,  4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  6,  4,
+/* C */	10,  9,  9,  9, 16, 11,  6, 11, 10,  9,  9,  0, 16, 16,  6, 11,
+/* D */	10,  9,  9, 10, 16, 11,  6, 11, 10,  3,  9,  9, 16,  0,  6, 11,
+/* E */	10,  9,  9, 16, 16, 11,  6, 11, 10,  3,  9,  3, 16,  0,  6, 11,
+/* F */	10,  9,  9,  3, 16, 11,  6, 11, 10,  4,  9,  3, 16,  0,  6, 11
+};
+
+static const unsigned char cyc_e180[128] = {	/* Z180 ED 00 - ED 7F */
+/*	 0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */	12, 13,  0,  0,  7,  0,  0,  0, 12, 13,  0,  0,  7,  0,  0,  0,
+/* 1 */	12, 13,  0,  0,  7,  0,  0,  0, 12, 13,  0,  0,  7,  0,  0,  0,
+/* 2 */	12, 13,  0,  0,  7,  0,  0,  0, 12, 13,  0,  0,  7,  0,  0,  0,
+/* 3 */	 0,  0,  0,  0, 10,  0,  0,  0, 12, 13,  0,  0,  7,  0,  0,  0,
+/* 4 */	 9, 10, 10, 19,  6, 12,  6,  6,  9, 10, 10, 18, 17, 12,  0,  6,
+/* 5 */	 9, 10, 10, 19,  0,  0,  6,  6,  9, 10, 10, 18, 17,  0,  6,  6,
+/* 6 */	 9, 10, 10, 19,  9,  0,  0, 16,  9, 10, 10, 18, 17,  0,  0, 16,
+/* 7 */	 0,  0, 10, 19, 12,  0,  8,  0,  9, 10, 10, 18, 17,  0,  0,  0
+};
+
+#define CYCSIZE	65536			/* size of Z80 address space */
+
+/*
+ *	structure for budgets of CYCLES
+ */
+struct budget {
+	char	*bu_fn;		/* file of CYCLES */
+	size_t	 bu_line;	/* line of CYCLES */
+	int	 bu_start;	/* address of first instruction */
+	int	 bu_end;	/* address behind last instruction */
+	int	 bu_max;	/* max. T-states */
+	int	 bu_min;	/* min. T-states, or -1 */
+};
+
+static int	cyc_z180(const int * const, const size_t, int * const);
+static int	cyc_z80n(const int, int * const);
+static int	cyc_hl(const int);
+
+static long	cyc_sum;		/* T-states since the last label */
+static char	cyc_col[32];		/* column for the listing */
+static unsigned char cyc_lo[CYCSIZE];	/* best case T-states by address */
+static unsigned char cyc_hi[CYCSIZE];	/* worst case T-states by address */
+static struct budget *budgets;		/* budgets of CYCLES */
+static size_t	nbudgets, sbudgets;	/* no. and size of budgets */
+
+/*
+ *	T-states of an instruction
+ *
+ *	Input: encoded instruction and its length
+ *	       pointer for the T-states if a condition isn't met
+ *
+ *	Output: T-states, if a condition is met for conditional
+ *		instructions, or -1 if unknown
+ */
+int
+cyc_count(const int * const op, const size_t n, int * const alt)
+{
+	int	c, t;
+
+	*alt = -1;
+	if (n == 0)
+		return (-1);
+	if (cpu_type == CPUZ180)
+		return (cyc_z180(op, n, alt));
+	c = op[0] & 0xff;
+	switch (c) {
+	case 0xcb:
+		if (n < 2)
+			return (-1);
+		c = op[1] & 0xff;
+		if ((c & 7) != 6)
+			return (8);
+		return (((c & 0xc0) == 0x40) ? 12 : 15);	/* BIT */
+	case 0xed:
+		if (n < 2)
+			return (-1);
+		c = op[1] & 0xff;
+		if (cpu_type == CPUZ80N && (t = cyc_z80n(c, alt)) > 0)
+			return (t);
+		if (c >= 0x40 && c < 0x80)
+			return (cyc_ed[c - 0x40]);
+		if ((c & 0xe4) != 0xa0)
+			return (-1);
+		if (c & 0x10)		/* LDIR ... OTDR: last round */
+			*alt = 16;
+		return ((c & 0x10) ? 21 : 16);
+	case 0xdd:
+	case 0xfd:
+		if (n < 2)
+			return (-1);
+		c = op[1] & 0xff;
+		if (c == 0xcb)		/* 20 for BIT */
+			return ((n < 4) ? -1 :
+			    ((op[3] & 0xc0) == 0x40) ? 20 : 23);
+		if (c == 0x36)		/* LD (IX+d),n */
+			return (19);
+		return (cyc_main[c] + (cyc_hl(c) ? 12 : 4));
+	}
+	t = cyc_main[c];
+	if (c == 0x10)				/* DJNZ */
+		*alt = 8;
+	else if ((c & 0xe7) == 0x20)		/* JR cc */
+		*alt = 7;
+	else if ((c & 0xc7) == 0xc0)		/* RET cc */
+		*alt = 5;
+	else if ((c & 0xc7) == 0xc2)		/* JP cc */
+		*alt = 10;
+	else if ((c & 0xc7) == 0xc4)		/* CALL cc */
+		*alt = 10;
+	return (t);
+}
+
+/*
+ *	T-states of an instruction for the Z180, as cyc_count()
+ */
+static int
+cyc_z180(const int * const op, const size_t n, int * const alt)
+{
+	int	c, t;
+
+	c = op[0] & 0xff;
+	switch (c) {
+	case 0xcb:
+		if (n < 2)
+			return (-1);
+		c = op[1] & 0xff;
+		if ((c & 0xc0) == 0x40)				/* BIT */
+			return (((c & 7) != 6) ? 6 : 9);
+		return (((c & 7) != 6) ? 7 : 13);
+	case 0xed:
+		if (n < 2)
+			return (-1);
+		c = op[1] & 0xff;
+		if (c < 0x80)
+			return (cyc_e180[c] ? cyc_e180[c] : -1);
+		if ((c & 0xf7) == 0x83)		/* OTIM, OTDM */
+			return (14);
+		if ((c & 0xf7) == 0x93) {		/* OTIMR, OTDMR */
+			*alt = 14;
+			return (16);
+		}
+		if ((c & 0xe4) != 0xa0)
+			return (-1);
+		if (c & 0x10)		/* LDIR ... OTDR: last round */
+			*alt = 12;
+		return ((c & 0x10) ? 14 : 12);
+	case 0xdd:
+	case 0xfd:
+		if (n < 2)
+			return (-1);
+		c = op[1] & 0xff;
+		if (c == 0xcb)		/* 15 for BIT */
+			return ((n < 4) ? -1 :
+			    ((op[3] & 0xc0) == 0x40) ? 15 : 19);
+		if (c == 0x36)		/* LD (IX+d),n */
+			return (15);
+		return (cyc_m180[c] + (cyc_hl(c) ? 8 : 3));
+	}
+	t = cyc_m180[c];
+	if (c == 0x10)				/* DJNZ */
+		*alt = 7;
+	else if ((c & 0xe7) == 0x20)		/* JR cc */
+		*alt = 6;
+	else if ((c & 0xc7) == 0xc0)		/* RET cc */
+		*alt = 5;
+	else if ((c & 0xc7) == 0xc2)		/* JP cc */
+		*alt = 6;
+	else if ((c & 0xc7) == 0xc4)		/* CALL cc */
+		*alt = 6;
+	return (t);
+}
+
+/*
+ *	T-states of the opcodes with ED added by the Z80N
+ *
+ *	Input: second byte of the opcode
+ *	       pointer for the T-states if a condition isn't met
+ *
+ *	Output: T-states, or -1 if not a Z80N opcode
+ */
+static int
+cyc_z80n(const int c, int * const alt)
+{
+	switch (c) {
+	case 0x23:				/* SWAPNIB */
+	case 0x24:				/* MIRROR */
+	case 0x28:				/* BSLA */
+	case 0x29:				/* BSRA */
+	case 0x2a:				/* BSRL */
+	case 0x2b:				/* BSRF */
+	case 0x2c:				/* BRLC */
+	case 0x30:				/* MUL */
+	case 0x31:				/* ADD HL,A */
+	case 0x32:				/* ADD DE,A */
+	case 0x33:				/* ADD BC,A */
+	case 0x93:				/* PIXELDN */
+	case 0x94:				/* PIXELAD */
+	case 0x95:				/* SETAE */
+		return (8);
+	case 0x27:				/* TEST n */
+		return (11);
+	case 0x34:				/* ADD HL,nn */
+	case 0x35:				/* ADD DE,nn */
+	case 0x36:				/* ADD BC,nn */
+	case 0x90:				/* OUTINB */
+	case 0xa4:				/* LDIX */
+	case 0xac:				/* LDDX */
+		return (16);
+	case 0x8a:				/* PUSH nn */
+		return (23);
+	case 0x91:				/* NEXTREG n,n */
+		return (20);
+	case 0x92:				/* NEXTREG n,A */
+		return (17);
+	case 0x98:				/* JP (C) */
+		return (13);
+	case 0xa5:				/* LDWS */
+		return (14);
+	case 0xb4:				/* LDIRX */
+	case 0xb7:				/* LDPIRX */
+	case 0xbc:				/* LDDRX */
+		*alt = 16;
+		return (21);
+	}
+	return (-1);
+}
+
+/*
+ *	check if an unprefixed instruction has the operand (HL),
+ *	which is (IX+d) with prefix DD or FD
+ */
+static int
+cyc_hl(const int c)
+{
+	if (c == 0x34 || c == 0x35)		/* INC/DEC (HL) */
+		return (1);
+	if (c >= 0x40 && c < 0x80 && c != 0x76)	/* LD r,r */
+		return ((c & 7) == 6 || (c & 0x38) == 0x30);
+	if (c >= 0x80 && c < 0xc0)		/* ALU */
+		return ((c & 7) == 6);
+	return (0);
+}
+
+/*
+ *	keep the T-states of the instruction of the line, and make the
+ *	column for the listing: a label starts a new running total,
+ *	which counts conditional instructions as not taken
+ *
+ *	Input: length of the instruction in ops[], 0 if no code
+ */
+void
+cyc_line(const size_t n)
+{
+	int	t, alt, a;
+
+	*cyc_col = '\0';
+	if (*label)
+		cyc_sum = 0;
+	if ((t = cyc_count(ops, n, &alt)) < 0)
+		return;
+	a = sect_addr(pc);
+	cyc_hi[a] = (unsigned char)((alt > t) ? alt : t);
+	cyc_lo[a] = (unsigned char)((alt >= 0 && alt < t) ? alt : t);
+	if (!cyc_flag)
+		return;
+	cyc_sum += (alt >= 0) ? alt : t;
+	if (alt >= 0)
+		snprintf(cyc_col, sizeof(cyc_col), "%2d/%-2d %6ld ", t, alt,
+		    cyc_sum);
+	else
+		snprintf(cyc_col, sizeof(cyc_col), "%5d %6ld ", t, cyc_sum);
+}
+
+/*
+ *	column of T-states for the listing line, cleared after use
+ */
+const char *
+cyc_list(void)
+{
+	static char	buf[sizeof(cyc_col)];
+
+	snprintf(buf, sizeof(buf), "%-13s", cyc_col);
+	*cyc_col = '\0';
+	return (buf);
+}
+
+/*
+ *	add a budget of T-states for the instructions from address
+ *	start up to address end, checked at the end of pass 2
+ *
+ *	Input: addresses, or positions in a relocatable object
+ *	       max. T-states of the worst case
+ *	       min. T-states of the best case, or -1
+ */
+void
+cyc_budget(const int start, const int end, const int max, const int min)
+{
+	struct budget	*bp;
+
+	if (nbudgets == sbudgets)
+		budgets = grow_tab(budgets, &sbudgets, sizeof(struct budget));
+	bp = &budgets[nbudgets++];
+	if ((bp->bu_fn = strdup(srcfn)) == NULL)
+		fatal(F_OUTMEM, "budgets");
+	bp->bu_line = c_line;
+	bp->bu_start = start;
+	bp->bu_end = end;
+	bp->bu_max = max;
+	bp->bu_min = min;
+}
+
+/*
+ *	check the budgets of T-states: the worst case, with conditions
+ *	taken or not, whatever costs more, must not exceed the max.
+ *	and the best case must reach the min.
+ */
+void
+cyc_check(void)
+{
+	size_t		 i;
+	int		 a;
+	long		 lo, hi;
+	struct budget	*bp;
+	char		 arg[64];
+
+	for (i = 0; i < nbudgets; i++) {
+		bp = &budgets[i];
+		lo = hi = 0;
+		for (a = bp->bu_start; a < bp->bu_end && a < CYCSIZE; a++) {
+			lo += cyc_lo[a];
+			hi += cyc_hi[a];
+		}
+		if (hi > bp->bu_max || (bp->bu_min >= 0 && lo < bp->bu_min)) {
+			snprintf(arg, sizeof(arg), "%04X-%04X %ld-%ld T-states",
+			    bp->bu_start & 0xffff, (bp->bu_end - 1) & 0xffff,
+			    lo, hi);
+			asmerr_at(E_BUDGET, bp->bu_fn, bp->bu_line, arg);
+		}
+	}
+}
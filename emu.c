@@ -0,0 +1,1085 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the Z80 interpreter, used to run the tests of -u
+ *	the opcodes are decoded by their x, y and z fields, flags are
+ *	looked up in tables built by emu_init(), the T-states are taken
+ *	from cyc.c by the bytes fetched
+ *	there are no interrupts, IN reads FFH and OUT is ignored
+ *	with -c z180 or -c z80n the opcodes added by the CPU are executed
+ *	too, NEXTREG is ignored like OUT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zz80asm.h"
+
+#define FC	0x01		/* flags */
+#define FN	0x02
+#define FP	0x04
+#define FH	0x10
+#define FZ	0x40
+#define FS	0x80
+#define FXY	0x28		/* undocumented bits 3 and 5 */
+
+#define RB	0		/* index of the registers in cp_reg */
+#define RC	1
+#define RD	2
+#define RE	3
+#define RH	4
+#define RL	5
+#define RF	6		/* (HL) in the opcodes */
+#define RA	7
+
+/*
+ *	structure decoding state of one instruction
+ */
+struct dec {
+	struct cpu	*de_cpu;	/* the CPU */
+	int		 de_pfx;	/* 0, or 1 for IX, 2 for IY */
+	int		 de_ea;		/* address of (HL), (IX+d) */
+	int		 de_hasea;	/* de_ea is valid */
+	int		 de_op[4];	/* bytes fetched, for the T-states */
+	size_t		 de_n;		/* no. of bytes fetched */
+	int		 de_taken;	/* condition met */
+};
+
+static int	 fetch(struct dec * const);
+static int	 fetch16(struct dec * const);
+static int	 rd16(const struct cpu * const, const int);
+static void	 wr16(struct cpu * const, const int, const int);
+static void	 push(struct cpu * const, const int);
+static int	 pop(struct cpu * const);
+static int	 get_rp(struct dec * const, const int);
+static void	 set_rp(struct dec * const, const int, const int);
+static int	 get_af(const struct cpu * const);
+static int	 addr_hl(struct dec * const);
+static int	 get_r(struct dec * const, const int, const int);
+static void	 set_r(struct dec * const, const int, const int, const int);
+static int	 cond(const struct cpu * const, const int);
+static void	 alu(struct cpu * const, const int, const int);
+static int	 rot(struct cpu * const, const int, const int);
+static int	 inc8(struct cpu * const, const int, const int);
+static void	 add16(struct dec * const, const int);
+static void	 adc16(struct cpu * const, const int, const int);
+static void	 exec_main(struct dec * const, const int);
+static void	 exec_cb(struct dec * const);
+static void	 exec_ed(struct dec * const);
+static void	 exec_block(struct dec * const, const int, const int);
+static int	 exec_z180(struct dec * const, const int);
+static int	 exec_z80n(struct dec * const, const int);
+static void	 exec_ldx(struct dec * const, const int);
+
+static uint8_t	 sz[256];	/* S, Z and bits 3 and 5 of a value */
+static uint8_t	 szp[256];	/* also the parity */
+
+/*
+ *	build the flag tables, before the CPU's run in threads
+ */
+void
+emu_init(void)
+{
+	int	i, p, b;
+
+	for (i = 0; i < 256; i++) {
+		sz[i] = (i & (FS | FXY)) | (i ? 0 : FZ);
+		for (p = FP, b = 0; b < 8; b++)
+			if (i & (1 << b))
+				p ^= FP;
+		szp[i] = sz[i] | p;
+	}
+}
+
+/*
+ *	execute one instruction
+ *
+ *	Output: T-states of the instruction
+ */
+int
+emu_step(struct cpu * const cp)
+{
+	struct dec	 d;
+	int		 op, alt, t;
+
+	memset(&d, 0, sizeof(d));
+	d.de_cpu = cp;
+	d.de_taken = 1;
+	cp->cp_r = (cp->cp_r & 0x80) | ((cp->cp_r + 1) & 0x7f);
+	op = fetch(&d);
+	if (op == 0xdd || op == 0xfd) {
+		d.de_pfx = (op == 0xdd) ? 1 : 2;
+		op = cp->cp_mem[cp->cp_pc];
+		if (op == 0xdd || op == 0xfd || op == 0xed)
+			return (4);	/* prefix is a NOP */
+		op = fetch(&d);
+	}
+	if (op == 0xcb)
+		exec_cb(&d);
+	else if (op == 0xed)
+		exec_ed(&d);
+	else
+		exec_main(&d, op);
+	if ((t = cyc_count(d.de_op, d.de_n, &alt)) <= 0)
+		t = 8;			/* undefined ED opcode */
+	if (!d.de_taken && alt >= 0)
+		t = alt;
+	return (t);
+}
+
+/*
+ *	unprefixed opcodes, or with DD or FD
+ */
+static void
+exec_main(struct dec * const dp, const int op)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 x, y, z, p, q, v, n, i;
+
+	x = op >> 6;
+	y = (op >> 3) & 7;
+	z = op & 7;
+	p = y >> 1;
+	q = y & 1;
+	switch (x) {
+	case 0:
+		switch (z) {
+		case 0:
+			switch (y) {
+			case 0:				/* NOP */
+				break;
+			case 1:				/* EX AF,AF' */
+				for (i = RF; i <= RA; i++) {
+					v = cp->cp_reg[i];
+					cp->cp_reg[i] = cp->cp_alt[i];
+					cp->cp_alt[i] = (uint8_t)v;
+				}
+				break;
+			case 2:				/* DJNZ */
+				n = (signed char)fetch(dp);
+				cp->cp_reg[RB]--;
+				if ((dp->de_taken = cp->cp_reg[RB] != 0))
+					cp->cp_pc = (cp->cp_pc + n) & 0xffff;
+				break;
+			default:			/* JR [cc,]d */
+				n = (signed char)fetch(dp);
+				if (y > 3)
+					dp->de_taken = cond(cp, y - 4);
+				if (dp->de_taken)
+					cp->cp_pc = (cp->cp_pc + n) & 0xffff;
+			}
+			break;
+		case 1:
+			if (q)				/* ADD HL,rr */
+				add16(dp, get_rp(dp, p));
+			else				/* LD rr,nn */
+				set_rp(dp, p, fetch16(dp));
+			break;
+		case 2:
+			switch (p) {
+			case 0:				/* (BC) */
+			case 1:				/* (DE) */
+				v = (cp->cp_reg[p * 2] << 8) |
+				    cp->cp_reg[p * 2 + 1];
+				if (q)
+					cp->cp_reg[RA] = cp->cp_mem[v];
+				else
+					cp->cp_mem[v] = cp->cp_reg[RA];
+				break;
+			case 2:				/* HL,(nn) */
+				v = fetch16(dp);
+				if (q)
+					set_rp(dp, 2, rd16(cp, v));
+				else
+					wr16(cp, v, get_rp(dp, 2));
+				break;
+			default:			/* A,(nn) */
+				v = fetch16(dp);
+				if (q)
+					cp->cp_reg[RA] = cp->cp_mem[v];
+				else
+					cp->cp_mem[v] = cp->cp_reg[RA];
+			}
+			break;
+		case 3:					/* INC/DEC rr */
+			set_rp(dp, p, get_rp(dp, p) + (q ? -1 : 1));
+			break;
+		case 4:					/* INC r */
+		case 5:					/* DEC r */
+			v = get_r(dp, y, 1);
+			set_r(dp, y, inc8(cp, v, z == 5), 1);
+			break;
+		case 6:					/* LD r,n */
+			if (y == 6)
+				addr_hl(dp);
+			set_r(dp, y, fetch(dp), 1);
+			break;
+		default:
+			exec_block(dp, -1, y);
+		}
+		break;
+	case 1:
+		if (op == 0x76) {			/* HALT */
+			cp->cp_halt = 1;
+			cp->cp_pc = (cp->cp_pc - 1) & 0xffff;
+		} else				/* LD r,r' */
+			set_r(dp, y, get_r(dp, z, z != 6 && y != 6),
+			    z != 6 && y != 6);
+		break;
+	case 2:					/* ALU r */
+		alu(cp, y, get_r(dp, z, 1));
+		break;
+	default:
+		switch (z) {
+		case 0:					/* RET cc */
+			if ((dp->de_taken = cond(cp, y)))
+				cp->cp_pc = pop(cp);
+			break;
+		case 1:
+			if (!q) {			/* POP */
+				v = pop(cp);
+				if (p == 3) {
+					cp->cp_reg[RA] = (uint8_t)(v >> 8);
+					cp->cp_reg[RF] = v & 0xff;
+				} else
+					set_rp(dp, p, v);
+				break;
+			}
+			switch (p) {
+			case 0:				/* RET */
+				cp->cp_pc = pop(cp);
+				break;
+			case 1:				/* EXX */
+				for (i = RB; i <= RL; i++) {
+					v = cp->cp_reg[i];
+					cp->cp_reg[i] = cp->cp_alt[i];
+					cp->cp_alt[i] = (uint8_t)v;
+				}
+				break;
+			case 2:				/* JP (HL) */
+				cp->cp_pc = get_rp(dp, 2);
+				break;
+			default:			/* LD SP,HL */
+				cp->cp_sp = get_rp(dp, 2);
+			}
+			break;
+		case 2:					/* JP cc,nn */
+			v = fetch16(dp);
+			if (cond(cp, y))
+				cp->cp_pc = v;
+			break;
+		case 3:
+			switch (y) {
+			case 0:				/* JP nn */
+				cp->cp_pc = fetch16(dp);
+				break;
+			case 2:				/* OUT (n),A */
+				fetch(dp);
+				break;
+			case 3:				/* IN A,(n) */
+				fetch(dp);
+				cp->cp_reg[RA] = 0xff;
+				break;
+			case 4:				/* EX (SP),HL */
+				v = rd16(cp, cp->cp_sp);
+				wr16(cp, cp->cp_sp, get_rp(dp, 2));
+				set_rp(dp, 2, v);
+				break;
+			case 5:				/* EX DE,HL */
+				for (i = RD; i <= RE; i++) {
+					v = cp->cp_reg[i];
+					cp->cp_reg[i] = cp->cp_reg[i + 2];
+					cp->cp_reg[i + 2] = (uint8_t)v;
+				}
+				break;
+			case 6:				/* DI */
+				cp->cp_iff = 0;
+				break;
+			case 7:				/* EI */
+				cp->cp_iff = 1;
+			}
+			break;
+		case 4:					/* CALL cc,nn */
+			v = fetch16(dp);
+			if ((dp->de_taken = cond(cp, y))) {
+				push(cp, cp->cp_pc);
+				cp->cp_pc = v;
+			}
+			break;
+		case 5:
+			if (!q) {			/* PUSH */
+				push(cp, (p == 3) ? get_af(cp) :
+				    get_rp(dp, p));
+				break;
+			}
+			v = fetch16(dp);		/* CALL nn */
+			push(cp, cp->cp_pc);
+			cp->cp_pc = v;
+			break;
+		case 6:					/* ALU n */
+			alu(cp, y, fetch(dp));
+			break;
+		default:				/* RST */
+			push(cp, cp->cp_pc);
+			cp->cp_pc = y * 8;
+		}
+	}
+}
+
+/*
+ *	opcodes with CB, DD CB or FD CB
+ */
+static void
+exec_cb(struct dec * const dp)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 op, x, y, z, v;
+
+	if (dp->de_pfx)
+		addr_hl(dp);		/* displacement is in front */
+	op = fetch(dp);
+	x = op >> 6;
+	y = (op >> 3) & 7;
+	z = dp->de_pfx ? 6 : op & 7;
+	v = get_r(dp, z, 0);
+	switch (x) {
+	case 0:					/* rotate and shift */
+		v = rot(cp, y, v);
+		break;
+	case 1:					/* BIT */
+		cp->cp_reg[RF] = (cp->cp_reg[RF] & FC) | FH | (v & FXY) |
+		    ((v & (1 << y)) ? (v & (1 << y) & FS) : (FZ | FP));
+		return;
+	case 2:					/* RES */
+		v &= ~(1 << y);
+		break;
+	default:				/* SET */
+		v |= 1 << y;
+	}
+	set_r(dp, z, v, 0);
+	if (dp->de_pfx && (op & 7) != 6)	/* copied into a register */
+		cp->cp_reg[op & 7] = (uint8_t)v;
+}
+
+/*
+ *	opcodes with ED
+ */
+static void
+exec_ed(struct dec * const dp)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 op, x, y, z, p, q, v, a;
+
+	dp->de_pfx = 0;
+	op = fetch(dp);
+	if (cpu_type == CPUZ180 && exec_z180(dp, op))
+		return;
+	if (cpu_type == CPUZ80N && exec_z80n(dp, op))
+		return;
+	x = op >> 6;
+	y = (op >> 3) & 7;
+	z = op & 7;
+	p = y >> 1;
+	q = y & 1;
+	if (x == 2 && y >= 4 && z <= 3) {
+		exec_block(dp, z, y);
+		return;
+	}
+	if (x != 1)
+		return;				/* NOP */
+	switch (z) {
+	case 0:					/* IN r,(C) */
+		cp->cp_reg[RF] = (cp->cp_reg[RF] & FC) | szp[0xff];
+		if (y != 6)
+			cp->cp_reg[y] = 0xff;
+		break;
+	case 1:					/* OUT (C),r */
+		break;
+	case 2:					/* SBC/ADC HL,rr */
+		adc16(cp, get_rp(dp, p), !q);
+		break;
+	case 3:					/* LD (nn),rr / rr,(nn) */
+		v = fetch16(dp);
+		if (q)
+			set_rp(dp, p, rd16(cp, v));
+		else
+			wr16(cp, v, get_rp(dp, p));
+		break;
+	case 4:					/* NEG */
+		v = cp->cp_reg[RA];
+		cp->cp_reg[RA] = 0;
+		alu(cp, 2, v);
+		break;
+	case 5:					/* RETN, RETI */
+		cp->cp_pc = pop(cp);
+		break;
+	case 6:					/* IM */
+		cp->cp_im = (y & 3) ? (y & 3) - 1 : 0;
+		break;
+	default:
+		a = cp->cp_reg[RA];
+		switch (y) {
+		case 0:				/* LD I,A */
+			cp->cp_i = (uint8_t)a;
+			break;
+		case 1:				/* LD R,A */
+			cp->cp_r = (uint8_t)a;
+			break;
+		case 2:				/* LD A,I */
+		case 3:				/* LD A,R */
+			a = (y == 2) ? cp->cp_i : cp->cp_r;
+			cp->cp_reg[RA] = (uint8_t)a;
+			cp->cp_reg[RF] = (cp->cp_reg[RF] & FC) | sz[a] |
+			    (cp->cp_iff ? FP : 0);
+			break;
+		case 4:				/* RRD */
+		case 5:				/* RLD */
+			v = cp->cp_mem[get_rp(dp, 2)];
+			if (y == 4) {
+				cp->cp_mem[get_rp(dp, 2)] =
+				    (uint8_t)((a << 4) | (v >> 4));
+				a = (a & 0xf0) | (v & 0x0f);
+			} else {
+				cp->cp_mem[get_rp(dp, 2)] =
+				    (uint8_t)((v << 4) | (a & 0x0f));
+				a = (a & 0xf0) | (v >> 4);
+			}
+			cp->cp_reg[RA] = (uint8_t)a;
+			cp->cp_reg[RF] = (cp->cp_reg[RF] & FC) | szp[a];
+		}
+	}
+}
+
+/*
+ *	the rotates of A, DAA, CPL, SCF and CCF for z == -1,
+ *	or the block instructions LDxx, CPxx, INxx and OUTxx for z >= 0
+ */
+static void
+exec_block(struct dec * const dp, const int z, const int y)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 a, f, v, r, c, inc, bc, hl, de;
+
+	a = cp->cp_reg[RA];
+	f = cp->cp_reg[RF];
+	if (z < 0) {
+		switch (y) {
+		case 0:				/* RLCA */
+			a = (a << 1) | (a >> 7);
+			f = (f & (FS | FZ | FP)) | (a & FC);
+			break;
+		case 1:				/* RRCA */
+			f = (f & (FS | FZ | FP)) | (a & FC);
+			a = (a >> 1) | (a << 7);
+			break;
+		case 2:				/* RLA */
+			c = a >> 7;
+			a = (a << 1) | (f & FC);
+			f = (f & (FS | FZ | FP)) | c;
+			break;
+		case 3:				/* RRA */
+			c = a & FC;
+			a = (a >> 1) | ((f & FC) << 7);
+			f = (f & (FS | FZ | FP)) | c;
+			break;
+		case 4:				/* DAA */
+			c = f & FC;
+			v = 0;
+			if ((f & FH) || (a & 0x0f) > 9)
+				v = 0x06;
+			if (c || a > 0x99) {
+				v |= 0x60;
+				c = FC;
+			}
+			r = (f & FN) ? a - v : a + v;
+			f = szp[r & 0xff] | c | (f & FN) | ((a ^ r) & FH);
+			a = r;
+			break;
+		case 5:				/* CPL */
+			a = ~a;
+			f = (f & (FS | FZ | FP | FC)) | FH | FN;
+			break;
+		case 6:				/* SCF */
+			f = (f & (FS | FZ | FP)) | FC;
+			break;
+		default:			/* CCF */
+			f = (f & (FS | FZ | FP)) | ((f & FC) ? FH : FC);
+		}
+		a &= 0xff;
+		cp->cp_reg[RA] = (uint8_t)a;
+		cp->cp_reg[RF] = (uint8_t)((f & ~FXY) | (a & FXY));
+		return;
+	}
+	inc = (y & 1) ? -1 : 1;			/* xxD : xxI */
+	bc = get_rp(dp, 0);
+	de = get_rp(dp, 1);
+	hl = get_rp(dp, 2);
+	switch (z) {
+	case 0:					/* LDI, LDD */
+		v = cp->cp_mem[hl];
+		cp->cp_mem[de] = (uint8_t)v;
+		set_rp(dp, 1, de + inc);
+		set_rp(dp, 2, hl + inc);
+		set_rp(dp, 0, --bc);
+		v += a;
+		f = (f & (FS | FZ | FC)) | (bc & 0xffff ? FP : 0) |
+		    (v & 0x08) | ((v << 4) & 0x20);
+		dp->de_taken = (bc & 0xffff) != 0;
+		break;
+	case 1:					/* CPI, CPD */
+		v = cp->cp_mem[hl];
+		r = (a - v) & 0xff;
+		set_rp(dp, 2, hl + inc);
+		set_rp(dp, 0, --bc);
+		f = (f & FC) | FN | (sz[r] & (FS | FZ)) | ((a ^ v ^ r) & FH) |
+		    (bc & 0xffff ? FP : 0);
+		dp->de_taken = (bc & 0xffff) != 0 && r != 0;
+		break;
+	default:				/* INI, IND, OUTI, OUTD */
+		if (z == 2)
+			cp->cp_mem[hl] = 0xff;
+		set_rp(dp, 2, hl + inc);
+		v = (cp->cp_reg[RB] - 1) & 0xff;
+		cp->cp_reg[RB] = (uint8_t)v;
+		f = FN | sz[v];
+		dp->de_taken = v != 0;
+	}
+	cp->cp_reg[RF] = (uint8_t)f;
+	if (y >= 6 && dp->de_taken)		/* repeat */
+		cp->cp_pc = (cp->cp_pc - 2) & 0xffff;
+	else if (y < 6)
+		dp->de_taken = 1;
+}
+
+/*
+ *	the opcodes with ED added by the Z180
+ *
+ *	Output: 1 if executed, 0 if not a Z180 opcode
+ */
+static int
+exec_z180(struct dec * const dp, const int op)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 y, v, inc;
+
+	y = (op >> 3) & 7;
+	if (op < 0x40) {
+		switch (op & 7) {
+		case 0:				/* IN0 r,(n) */
+			fetch(dp);
+			cp->cp_reg[RF] = (cp->cp_reg[RF] & FC) | szp[0xff];
+			if (y != 6)
+				cp->cp_reg[y] = 0xff;
+			return (1);
+		case 1:				/* OUT0 (n),r */
+			fetch(dp);
+			return (1);
+		case 4:				/* TST r, TST (HL) */
+			v = (y == 6) ? cp->cp_mem[get_rp(dp, 2)] :
+			    cp->cp_reg[y];
+			cp->cp_reg[RF] = szp[cp->cp_reg[RA] & v] | FH;
+			return (1);
+		}
+		return (0);
+	}
+	switch (op) {
+	case 0x4c:				/* MLT BC */
+	case 0x5c:				/* MLT DE */
+	case 0x6c:				/* MLT HL */
+	case 0x7c:				/* MLT SP */
+		v = get_rp(dp, y >> 1);
+		set_rp(dp, y >> 1, (v >> 8) * (v & 0xff));
+		return (1);
+	case 0x64:				/* TST n */
+		cp->cp_reg[RF] = szp[cp->cp_reg[RA] & fetch(dp)] | FH;
+		return (1);
+	case 0x74:				/* TSTIO n */
+		cp->cp_reg[RF] = szp[0xff & fetch(dp)] | FH;
+		return (1);
+	case 0x76:				/* SLP */
+		cp->cp_halt = 1;
+		return (1);
+	case 0x83:				/* OTIM */
+	case 0x8b:				/* OTDM */
+	case 0x93:				/* OTIMR */
+	case 0x9b:				/* OTDMR */
+		inc = (op & 0x08) ? -1 : 1;
+		set_rp(dp, 2, get_rp(dp, 2) + inc);
+		cp->cp_reg[RC] = (uint8_t)(cp->cp_reg[RC] + inc);
+		v = (cp->cp_reg[RB] - 1) & 0xff;
+		cp->cp_reg[RB] = (uint8_t)v;
+		cp->cp_reg[RF] = FN | sz[v];
+		if (op & 0x10) {		/* repeat */
+			dp->de_taken = v != 0;
+			if (v != 0)
+				cp->cp_pc = (cp->cp_pc - 2) & 0xffff;
+		}
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ *	the opcodes with ED added by the Z80N, they don't change the
+ *	flags but TEST n and LDWS
+ *
+ *	Output: 1 if executed, 0 if not a Z80N opcode
+ */
+static int
+exec_z80n(struct dec * const dp, const int op)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 a, v, n, i;
+
+	a = cp->cp_reg[RA];
+	v = get_rp(dp, 1);			/* DE */
+	n = cp->cp_reg[RB] & 0x1f;
+	switch (op) {
+	case 0x23:				/* SWAPNIB */
+		cp->cp_reg[RA] = (uint8_t)((a << 4) | (a >> 4));
+		return (1);
+	case 0x24:				/* MIRROR */
+		for (v = 0, i = 0; i < 8; i++)
+			if (a & (1 << i))
+				v |= 0x80 >> i;
+		cp->cp_reg[RA] = (uint8_t)v;
+		return (1);
+	case 0x27:				/* TEST n */
+		cp->cp_reg[RF] = szp[a & fetch(dp)] | FH;
+		return (1);
+	case 0x28:				/* BSLA DE,B */
+		set_rp(dp, 1, (n > 15) ? 0 : v << n);
+		return (1);
+	case 0x29:				/* BSRA DE,B */
+		n = (n > 15) ? 15 : n;
+		set_rp(dp, 1, (v >> n) |
+		    ((v & 0x8000) ? 0xffff << (16 - n) : 0));
+		return (1);
+	case 0x2a:				/* BSRL DE,B */
+		set_rp(dp, 1, (n > 15) ? 0 : v >> n);
+		return (1);
+	case 0x2b:				/* BSRF DE,B */
+		set_rp(dp, 1, (n > 15) ? 0xffff :
+		    (v >> n) | (0xffff << (16 - n)));
+		return (1);
+	case 0x2c:				/* BRLC DE,B */
+		n &= 0x0f;
+		set_rp(dp, 1, (v << n) | (v >> (16 - n)));
+		return (1);
+	case 0x30:				/* MUL D,E */
+		set_rp(dp, 1, (v >> 8) * (v & 0xff));
+		return (1);
+	case 0x31:				/* ADD HL,A */
+	case 0x32:				/* ADD DE,A */
+	case 0x33:				/* ADD BC,A */
+		i = (0x33 - op) & 3;
+		set_rp(dp, i, get_rp(dp, i) + a);
+		return (1);
+	case 0x34:				/* ADD HL,nn */
+	case 0x35:				/* ADD DE,nn */
+	case 0x36:				/* ADD BC,nn */
+		i = (0x36 - op) & 3;
+		set_rp(dp, i, get_rp(dp, i) + fetch16(dp));
+		return (1);
+	case 0x8a:				/* PUSH nn, high first */
+		v = fetch(dp) << 8;
+		push(cp, v | fetch(dp));
+		return (1);
+	case 0x90:				/* OUTINB */
+		set_rp(dp, 2, get_rp(dp, 2) + 1);
+		return (1);
+	case 0x91:				/* NEXTREG n,n */
+		fetch(dp);
+		fetch(dp);
+		return (1);
+	case 0x92:				/* NEXTREG n,A */
+		fetch(dp);
+		return (1);
+	case 0x93:				/* PIXELDN */
+		v = get_rp(dp, 2);
+		if ((v & 0x0700) != 0x0700)
+			v += 0x0100;
+		else if ((v & 0xe0) != 0xe0)
+			v = (v & 0xf8ff) + 0x20;
+		else
+			v = (v & 0xf81f) + 0x0800;
+		set_rp(dp, 2, v);
+		return (1);
+	case 0x94:				/* PIXELAD */
+		set_rp(dp, 2, 0x4000 + ((v & 0xc000) >> 3) +
+		    (v & 0x0700) + ((v & 0x3800) >> 6) + ((v & 0xff) >> 3));
+		return (1);
+	case 0x95:				/* SETAE */
+		cp->cp_reg[RA] = (uint8_t)(0x80 >> (v & 7));
+		return (1);
+	case 0x98:				/* JP (C), IN reads FFH */
+		cp->cp_pc = (cp->cp_pc & 0xc000) | (0xff << 6);
+		return (1);
+	case 0xa4:				/* LDIX */
+	case 0xa5:				/* LDWS */
+	case 0xac:				/* LDDX */
+	case 0xb4:				/* LDIRX */
+	case 0xb7:				/* LDPIRX */
+	case 0xbc:				/* LDDRX */
+		exec_ldx(dp, op);
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ *	the block copies of the Z80N, LDIX, LDDX and their repeats
+ *	skip the bytes equal to A
+ */
+static void
+exec_ldx(struct dec * const dp, const int op)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 bc, de, hl, v;
+
+	bc = get_rp(dp, 0);
+	de = get_rp(dp, 1);
+	hl = get_rp(dp, 2);
+	if (op == 0xa5) {			/* LDWS */
+		cp->cp_mem[de] = cp->cp_mem[hl];
+		cp->cp_reg[RL] = (uint8_t)(hl + 1);
+		cp->cp_reg[RD] = (uint8_t)inc8(cp, de >> 8, 0);
+		return;
+	}
+	if (op == 0xb7)				/* LDPIRX, 8 byte pattern */
+		v = cp->cp_mem[(hl & 0xfff8) | (de & 7)];
+	else {
+		v = cp->cp_mem[hl];
+		set_rp(dp, 2, hl + ((op & 0x08) ? -1 : 1));
+	}
+	if (v != cp->cp_reg[RA])
+		cp->cp_mem[de] = (uint8_t)v;
+	set_rp(dp, 1, de + 1);
+	set_rp(dp, 0, --bc);
+	if (op & 0x10) {			/* repeat */
+		dp->de_taken = (bc & 0xffff) != 0;
+		if (dp->de_taken)
+			cp->cp_pc = (cp->cp_pc - 2) & 0xffff;
+	}
+}
+
+/*
+ *	fetch the next byte of the instruction
+ */
+static int
+fetch(struct dec * const dp)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 v;
+
+	v = cp->cp_mem[cp->cp_pc];
+	cp->cp_pc = (cp->cp_pc + 1) & 0xffff;
+	if (dp->de_n < sizeof(dp->de_op) / sizeof(dp->de_op[0]))
+		dp->de_op[dp->de_n++] = v;
+	return (v);
+}
+
+static int
+fetch16(struct dec * const dp)
+{
+	int	v;
+
+	v = fetch(dp);
+	return (v | (fetch(dp) << 8));
+}
+
+static int
+rd16(const struct cpu * const cp, const int a)
+{
+	return (cp->cp_mem[a & 0xffff] | (cp->cp_mem[(a + 1) & 0xffff] << 8));
+}
+
+static void
+wr16(struct cpu * const cp, const int a, const int v)
+{
+	cp->cp_mem[a & 0xffff] = v & 0xff;
+	cp->cp_mem[(a + 1) & 0xffff] = (v >> 8) & 0xff;
+}
+
+static void
+push(struct cpu * const cp, const int v)
+{
+	cp->cp_sp = (cp->cp_sp - 2) & 0xffff;
+	wr16(cp, cp->cp_sp, v);
+}
+
+static int
+pop(struct cpu * const cp)
+{
+	int	v;
+
+	v = rd16(cp, cp->cp_sp);
+	cp->cp_sp = (cp->cp_sp + 2) & 0xffff;
+	return (v);
+}
+
+/*
+ *	register pair BC, DE, HL (or IX, IY) and SP
+ */
+static int
+get_rp(struct dec * const dp, const int p)
+{
+	struct cpu	*cp = dp->de_cpu;
+
+	if (p == 3)
+		return (cp->cp_sp);
+	if (p == 2 && dp->de_pfx)
+		return ((dp->de_pfx == 1) ? cp->cp_ix : cp->cp_iy);
+	return ((cp->cp_reg[p * 2] << 8) | cp->cp_reg[p * 2 + 1]);
+}
+
+static void
+set_rp(struct dec * const dp, const int p, const int v)
+{
+	struct cpu	*cp = dp->de_cpu;
+
+	if (p == 3)
+		cp->cp_sp = v & 0xffff;
+	else if (p == 2 && dp->de_pfx == 1)
+		cp->cp_ix = v & 0xffff;
+	else if (p == 2 && dp->de_pfx == 2)
+		cp->cp_iy = v & 0xffff;
+	else {
+		cp->cp_reg[p * 2] = (v >> 8) & 0xff;
+		cp->cp_reg[p * 2 + 1] = v & 0xff;
+	}
+}
+
+static int
+get_af(const struct cpu * const cp)
+{
+	return ((cp->cp_reg[RA] << 8) | cp->cp_reg[RF]);
+}
+
+/*
+ *	address of (HL), or (IX+d) with the displacement fetched once
+ */
+static int
+addr_hl(struct dec * const dp)
+{
+	if (!dp->de_hasea) {
+		dp->de_ea = get_rp(dp, 2);
+		if (dp->de_pfx)
+			dp->de_ea = (dp->de_ea + (signed char)fetch(dp)) &
+			    0xffff;
+		dp->de_hasea = 1;
+	}
+	return (dp->de_ea);
+}
+
+/*
+ *	8 bit register r of the opcode, 6 is (HL), with IX or IY
+ *	H and L are the halves of the index register if ix is set
+ */
+static int
+get_r(struct dec * const dp, const int r, const int ix)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 v;
+
+	if (r == 6)
+		return (cp->cp_mem[addr_hl(dp)]);
+	if ((r == RH || r == RL) && ix && dp->de_pfx) {
+		v = get_rp(dp, 2);
+		return ((r == RH) ? v >> 8 : v & 0xff);
+	}
+	return (cp->cp_reg[r]);
+}
+
+static void
+set_r(struct dec * const dp, const int r, const int v, const int ix)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 w;
+
+	if (r == 6)
+		cp->cp_mem[addr_hl(dp)] = v & 0xff;
+	else if ((r == RH || r == RL) && ix && dp->de_pfx) {
+		w = get_rp(dp, 2);
+		w = (r == RH) ? (w & 0xff) | ((v & 0xff) << 8) :
+		    (w & 0xff00) | (v & 0xff);
+		set_rp(dp, 2, w);
+	} else
+		cp->cp_reg[r] = v & 0xff;
+}
+
+/*
+ *	condition NZ, Z, NC, C, PO, PE, P, M
+ */
+static int
+cond(const struct cpu * const cp, const int c)
+{
+	static const int	mask[4] = { FZ, FC, FP, FS };
+
+	return (((cp->cp_reg[RF] & mask[c >> 1]) != 0) == (c & 1));
+}
+
+/*
+ *	ADD, ADC, SUB, SBC, AND, XOR, OR, CP with A
+ */
+static void
+alu(struct cpu * const cp, const int op, const int v)
+{
+	int	a, r, f, c;
+
+	a = cp->cp_reg[RA];
+	c = (op == 1 || op == 3) ? cp->cp_reg[RF] & FC : 0;
+	switch (op) {
+	case 0:					/* ADD */
+	case 1:					/* ADC */
+		r = a + v + c;
+		f = sz[r & 0xff] | ((r >> 8) & FC) | ((a ^ v ^ r) & FH) |
+		    ((((a ^ ~v) & (a ^ r)) & 0x80) ? FP : 0);
+		break;
+	case 4:					/* AND */
+		r = a & v;
+		f = szp[r] | FH;
+		break;
+	case 5:					/* XOR */
+		r = a ^ v;
+		f = szp[r];
+		break;
+	case 6:					/* OR */
+		r = a | v;
+		f = szp[r];
+		break;
+	default:				/* SUB, SBC, CP */
+		r = a - v - c;
+		f = sz[r & 0xff] | FN | ((r >> 8) & FC) | ((a ^ v ^ r) & FH) |
+		    ((((a ^ v) & (a ^ r)) & 0x80) ? FP : 0);
+		if (op == 7) {
+			cp->cp_reg[RF] = (uint8_t)((f & ~FXY) | (v & FXY));
+			return;
+		}
+	}
+	cp->cp_reg[RA] = r & 0xff;
+	cp->cp_reg[RF] = (uint8_t)f;
+}
+
+/*
+ *	RLC, RRC, RL, RR, SLA, SRA, SLL, SRL
+ */
+static int
+rot(struct cpu * const cp, const int op, const int v)
+{
+	int	r, c;
+
+	c = (op & 1) ? v & 1 : v >> 7;
+	switch (op) {
+	case 0:
+		r = (v << 1) | c;
+		break;
+	case 1:
+		r = (v >> 1) | (c << 7);
+		break;
+	case 2:
+		r = (v << 1) | (cp->cp_reg[RF] & FC);
+		break;
+	case 3:
+		r = (v >> 1) | ((cp->cp_reg[RF] & FC) << 7);
+		break;
+	case 4:
+		r = v << 1;
+		break;
+	case 5:
+		r = (v >> 1) | (v & 0x80);
+		break;
+	case 6:
+		r = (v << 1) | 1;
+		break;
+	default:
+		r = v >> 1;
+	}
+	r &= 0xff;
+	cp->cp_reg[RF] = szp[r] | (uint8_t)c;
+	return (r);
+}
+
+/*
+ *	INC and DEC of an 8 bit value
+ */
+static int
+inc8(struct cpu * const cp, const int v, const int dec)
+{
+	int	r, f;
+
+	f = cp->cp_reg[RF] & FC;
+	if (dec) {
+		r = (v - 1) & 0xff;
+		f |= FN | sz[r] | ((r == 0x7f) ? FP : 0) |
+		    (((r & 0x0f) == 0x0f) ? FH : 0);
+	} else {
+		r = (v + 1) & 0xff;
+		f |= sz[r] | ((r == 0x80) ? FP : 0) |
+		    (((r & 0x0f) == 0) ? FH : 0);
+	}
+	cp->cp_reg[RF] = (uint8_t)f;
+	return (r);
+}
+
+/*
+ *	ADD HL,rr, also with IX and IY
+ */
+static void
+add16(struct dec * const dp, const int v)
+{
+	struct cpu	*cp = dp->de_cpu;
+	int		 hl, r;
+
+	hl = get_rp(dp, 2);
+	r = hl + v;
+	cp->cp_reg[RF] = (cp->cp_reg[RF] & (FS | FZ | FP)) |
+	    ((r >> 16) & FC) | (((hl ^ v ^ r) >> 8) & FH) |
+	    ((r >> 8) & FXY);
+	set_rp(dp, 2, r);
+}
+
+/*
+ *	ADC HL,rr and SBC HL,rr
+ */
+static void
+adc16(struct cpu * const cp, const int v, const int sub)
+{
+	int	hl, r, c, f;
+
+	hl = (cp->cp_reg[RH] << 8) | cp->cp_reg[RL];
+	c = cp->cp_reg[RF] & FC;
+	if (sub) {
+		r = hl - v - c;
+		f = FN | ((((hl ^ v) & (hl ^ r)) & 0x8000) ? FP : 0);
+	} else {
+		r = hl + v + c;
+		f = (((hl ^ ~v) & (hl ^ r)) & 0x8000) ? FP : 0;
+	}
+	f |= ((r >> 8) & (FS | FXY)) | ((r & 0xffff) ? 0 : FZ) |
+	    (((hl ^ v ^ r) >> 8) & FH) | ((r >> 16) & FC);
+	cp->cp_reg[RH] = (r >> 8) & 0xff;
+	cp->cp_reg[RL] = r & 0xff;
+	cp->cp_reg[RF] = (uint8_t)f;
+}
@@ -0,0 +1,676 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the linker
+ *	the sections of relocatable objects written with -f r are placed
+ *	one after the other from an origin, grouped by name and with
+ *	uninitialised sections last, with -p gaps left by aligned sections
+ *	are filled with other sections; external symbols are resolved
+ *	against the public symbols of all objects and the relocations are
+ *	applied; with an entry point, sections not reachable from it
+ *	through the relocations are left out
+ *	the objects are loaded and relocated by one thread per CPU
+ */
+
+#include <err.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zz80asm.h"
+
+#define IMGSIZE	65536		/* size of Z80 address space */
+
+/*
+ *	structure sections of an object
+ */
+struct lsect {
+	char		 ls_name[SYMSIZE + 1];	/* name of section */
+	int		 ls_size;	/* size of section */
+	int		 ls_base;	/* address of section */
+	int		 ls_live;	/* section is reachable */
+	int		 ls_bss;	/* section is uninitialised */
+	int		 ls_align;	/* alignment of the address */
+	unsigned char	*ls_buf;	/* contents of section */
+	unsigned char	*ls_set;	/* bytes of section written */
+	struct module	*ls_mod;	/* object of section */
+};
+
+/*
+ *	structure relocations of an object
+ */
+struct lrel {
+	int	lr_sect;	/* section of the word */
+	int	lr_off;		/* offset of word in section */
+	int	lr_kind;	/* relative to section 'S' or external 'X' */
+	int	lr_no;		/* no. of section or external symbol */
+};
+
+/*
+ *	structure public symbols of an object
+ */
+struct lpub {
+	char		 lp_name[SYMSIZE + 1];	/* name of symbol */
+	int		 lp_sect;	/* section of symbol, 0 if absolute */
+	int		 lp_val;	/* value of symbol */
+	struct module	*lp_mod;	/* object of symbol */
+};
+
+/*
+ *	structure objects to be linked
+ */
+struct module {
+	char		 *mod_fn;	/* filename of object */
+	struct lsect	 *mod_sect;	/* sections */
+	size_t		  mod_nsect, mod_ssect;
+	char		(*mod_ext)[SYMSIZE + 1]; /* external symbols */
+	size_t		  mod_next, mod_sext;
+	struct lrel	 *mod_rel;	/* relocations */
+	size_t		  mod_nrel, mod_srel;
+	struct lpub	 *mod_pub;	/* public symbols */
+	size_t		  mod_npub, mod_spub;
+	unsigned long	  mod_getsym;	/* symbols looked up, for -T */
+	unsigned long	  mod_probes;	/* symbols compared, for -T */
+};
+
+static void		 mod_load(struct module * const);
+static struct lsect	*mod_sect(struct module * const, const int);
+static void		 mod_reloc(struct module * const);
+static void		 run_mods(void (*)(struct module * const));
+static void		*run_worker(void *);
+static void		 def_pubs(const int);
+static struct lsect	*sym_sect(const char * const);
+static void		 mark_live(char ** const);
+static int		 place_sects(int);
+static int		 place_name(const struct lsect * const, size_t, int);
+static void		 place_fill(int, const int, const int);
+static void		 img_write(const int, const char * const);
+static void		 map_write(const char * const);
+
+static struct module	*mods;		/* objects to be linked */
+static size_t		 nmods;		/* no. of objects */
+static size_t		 nextmod;	/* next object for a worker thread */
+static void		(*modfun)(struct module * const); /* work on object */
+static pthread_mutex_t	 mod_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct lpub	**pubtab;	/* public symbols by index */
+static size_t		 npub, spub;	/* no. and size of pubtab */
+
+static unsigned char	 img_buf[IMGSIZE];	/* linked image */
+static unsigned char	 img_set[IMGSIZE];	/* bytes of image written */
+
+/*
+ *	link relocatable objects
+ *
+ *	Input: NULL terminated list of objects
+ *	       address of the first object
+ *	       name of output file
+ *	       name of map file, or NULL
+ *	       NULL terminated list of entry point and symbols to keep,
+ *	       or NULL to keep all sections
+ *
+ *	Output: no. of errors
+ */
+int
+link_files(char ** const files, const int origin, const char * const out,
+    const char * const map, char ** const roots)
+{
+	size_t		 i, j;
+	int		 a, base;
+	struct lsect	*sp;
+
+	for (nmods = 0; files[nmods] != NULL; nmods++)
+		;
+	if ((mods = calloc(nmods, sizeof(struct module))) == NULL)
+		fatal(F_OUTMEM, "objects");
+	for (i = 0; i < nmods; i++)
+		mods[i].mod_fn = files[i];
+	pass = 1;
+	run_mods(mod_load);
+	gencode = 1;
+	if (roots != NULL) {
+		def_pubs(0);		/* symbols refer to public entries */
+		mark_live(roots);
+		clr_sym();
+	} else
+		for (i = 0; i < nmods; i++)
+			for (j = 0; j < mods[i].mod_nsect; j++)
+				mods[i].mod_sect[j].ls_live = 1;
+	base = place_sects(origin);
+	if (base > IMGSIZE) {
+		fprintf(errfp, "image too large: %04X - %X\n", origin, base);
+		return (1);
+	}
+	def_pubs(1);
+	pass = 2;
+	run_mods(mod_reloc);
+	for (i = 0; i < nmods; i++) {	/* counted by the workers */
+		perf.pf_getsym += mods[i].mod_getsym;
+		perf.pf_probes += mods[i].mod_probes;
+	}
+	for (i = 0; i < nmods; i++) {	/* copy sections into image */
+		for (j = 0; j < mods[i].mod_nsect; j++) {
+			sp = &mods[i].mod_sect[j];
+			if (!sp->ls_live)
+				continue;
+			for (a = 0; a < sp->ls_size; a++)
+				if (sp->ls_set[a >> 3] & (1 << (a & 7))) {
+					img_buf[sp->ls_base + a] =
+					    sp->ls_buf[a];
+					img_set[sp->ls_base + a] = 1;
+				}
+		}
+	}
+	if (errors == 0) {
+		img_write(origin, out);
+		if (map != NULL)
+			map_write(map);
+	}
+	return (errors);
+}
+
+/*
+ *	place the live sections from address base: for every section name
+ *	in the order they are first seen, the sections of all objects
+ *	with this name, the uninitialised sections after all others
+ *
+ *	Output: address behind the last section
+ */
+static int
+place_sects(int base)
+{
+	size_t		 i, j;
+	int		 bss;
+	struct lsect	*sp;
+
+	for (i = 0; i < nmods; i++)
+		for (j = 0; j < mods[i].mod_nsect; j++)
+			mods[i].mod_sect[j].ls_base = -1;
+	for (bss = 0; bss < 2; bss++)
+		for (i = 0; i < nmods; i++)
+			for (j = 0; j < mods[i].mod_nsect; j++) {
+				sp = &mods[i].mod_sect[j];
+				if (sp->ls_bss == bss && sp->ls_base < 0)
+					base = place_name(sp, i, base);
+			}
+	return (base);
+}
+
+/*
+ *	place the live sections named like section np, of the
+ *	objects from no. i on, from address base
+ *
+ *	Output: address behind the last section
+ */
+static int
+place_name(const struct lsect * const np, size_t i, int base)
+{
+	size_t		 j;
+	struct lsect	*sp;
+
+	for (; i < nmods; i++)
+		for (j = 0; j < mods[i].mod_nsect; j++) {
+			sp = &mods[i].mod_sect[j];
+			if (sp->ls_bss != np->ls_bss || sp->ls_base >= 0 ||
+			    strcmp(sp->ls_name, np->ls_name) != 0)
+				continue;
+			if (!sp->ls_live) {
+				sp->ls_base = 0;
+				if (ver_flag)
+					fprintf(stdout, "   Remove  %s %s\n",
+					    mods[i].mod_fn, sp->ls_name);
+				continue;
+			}
+			sp->ls_base = ALIGNUP(base, sp->ls_align);
+			if (pack_flag)
+				place_fill(base, sp->ls_base, sp->ls_bss);
+			base = sp->ls_base + sp->ls_size;
+		}
+	return (base);
+}
+
+/*
+ *	fill the gap from address a up to address end with live
+ *	sections not yet placed, each at the first address it fits
+ *
+ *	Input: start and end of the gap
+ *	       1 if the gap is between uninitialised sections
+ */
+static void
+place_fill(int a, const int end, const int bss)
+{
+	size_t		 i, j;
+	int		 base;
+	struct lsect	*sp;
+
+	for (i = 0; i < nmods && a < end; i++)
+		for (j = 0; j < mods[i].mod_nsect && a < end; j++) {
+			sp = &mods[i].mod_sect[j];
+			if (sp->ls_bss != bss || sp->ls_base >= 0 ||
+			    !sp->ls_live)
+				continue;
+			base = ALIGNUP(a, sp->ls_align);
+			if (base + sp->ls_size > end)
+				continue;
+			sp->ls_base = base;
+			a = base + sp->ls_size;
+		}
+}
+
+/*
+ *	run function on all objects, in as many threads as there are CPU's
+ */
+static void
+run_mods(void (*fun)(struct module * const))
+{
+	long		 i, n;
+	pthread_t	*tids;
+
+	modfun = fun;
+	nextmod = 0;
+	if ((n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		n = 1;
+	if ((size_t)n > nmods)
+		n = (long)nmods;
+	if (n <= 1) {
+		run_worker(NULL);
+		return;
+	}
+	if ((tids = calloc((size_t)n, sizeof(pthread_t))) == NULL)
+		fatal(F_OUTMEM, "threads");
+	for (i = 0; i < n; i++)
+		if (pthread_create(&tids[i], NULL, run_worker, NULL) != 0)
+			errx(1, "can't create thread");
+	for (i = 0; i < n; i++)
+		pthread_join(tids[i], NULL);
+	free(tids);
+}
+
+/*
+ *	worker thread: take the next object until all are done
+ */
+static void *
+run_worker(void *arg)
+{
+	size_t	i;
+
+	(void)arg;
+	for (;;) {
+		pthread_mutex_lock(&mod_mtx);
+		i = nextmod++;
+		pthread_mutex_unlock(&mod_mtx);
+		if (i >= nmods)
+			break;
+		(*modfun)(&mods[i]);
+	}
+	return (NULL);
+}
+
+/*
+ *	define the public symbols of all objects: with the final
+ *	addresses of the reachable sections, or with the index in
+ *	pubtab, used to find the reachable sections
+ *
+ *	Input: 1 final addresses, 0 index
+ */
+static void
+def_pubs(const int final)
+{
+	size_t		 i, j;
+	struct module	*mp;
+	struct lpub	*pp;
+
+	npub = 0;
+	for (i = 0; i < nmods; i++) {
+		mp = &mods[i];
+		for (j = 0; j < mp->mod_npub; j++) {
+			pp = &mp->mod_pub[j];
+			if (final && pp->lp_sect &&
+			    !mod_sect(mp, pp->lp_sect)->ls_live)
+				continue;
+			if (get_sym(pp->lp_name) != NULL) {
+				if (final) {
+					fprintf(errfp, "%s: multiply defined "
+					    "symbol %s\n", mp->mod_fn,
+					    pp->lp_name);
+					errors++;
+				}
+				continue;
+			}
+			if (!final) {
+				if (npub == spub)
+					pubtab = grow_tab(pubtab, &spub,
+					    sizeof(struct lpub *));
+				pubtab[npub] = pp;
+			}
+			if (put_sym(pp->lp_name, final ? pp->lp_val +
+			    (pp->lp_sect ? mod_sect(mp, pp->lp_sect)->ls_base :
+			    0) : (int)npub++))
+				fatal(F_OUTMEM, "symbols");
+		}
+	}
+}
+
+/*
+ *	section a symbol refers to
+ *
+ *	Output: section, or NULL if the symbol is undefined or absolute
+ */
+static struct lsect *
+sym_sect(const char * const name)
+{
+	struct sym	*np;
+	struct lpub	*pp;
+
+	if ((np = get_sym(name)) == NULL)
+		return (NULL);
+	pp = pubtab[np->sym_val];
+	if (pp->lp_sect == 0)
+		return (NULL);
+	return (mod_sect(pp->lp_mod, pp->lp_sect));
+}
+
+/*
+ *	mark all sections reachable through relocations
+ *	from the sections of the root symbols as live
+ */
+static void
+mark_live(char ** const roots)
+{
+	size_t		  i, nstack, sstack;
+	struct lsect	**stack, *sp, *tp;
+	struct module	 *mp;
+	struct lrel	 *rp;
+	char		**r;
+
+	stack = NULL;
+	nstack = sstack = 0;
+	for (r = roots; *r != NULL; r++) {
+		if (get_sym(*r) == NULL) {
+			fprintf(errfp, "undefined symbol %s\n", *r);
+			errors++;
+			continue;
+		}
+		if ((sp = sym_sect(*r)) == NULL || sp->ls_live)
+			continue;
+		sp->ls_live = 1;
+		if (nstack == sstack)
+			stack = grow_tab(stack, &sstack,
+			    sizeof(struct lsect *));
+		stack[nstack++] = sp;
+		while (nstack > 0) {
+			sp = stack[--nstack];
+			mp = sp->ls_mod;
+			for (i = 0; i < mp->mod_nrel; i++) {
+				rp = &mp->mod_rel[i];
+				if (mod_sect(mp, rp->lr_sect) != sp)
+					continue;
+				tp = (rp->lr_kind == 'S') ?
+				    mod_sect(mp, rp->lr_no) :
+				    sym_sect(mp->mod_ext[rp->lr_no - 1]);
+				if (tp == NULL || tp->ls_live)
+					continue;
+				tp->ls_live = 1;
+				if (nstack == sstack)
+					stack = grow_tab(stack, &sstack,
+					    sizeof(struct lsect *));
+				stack[nstack++] = tp;
+			}
+		}
+	}
+	free(stack);
+}
+
+/*
+ *	read a relocatable object
+ */
+static void
+mod_load(struct module * const mp)
+{
+	FILE		*fp;
+	char		 buf[LINE_MAX], name[LINE_MAX], kind;
+	char		*p, *ep;
+	size_t		 ln;
+	int		 vers, no, sect, pos, done, n;
+	unsigned int	 size, off, val;
+	unsigned long	 b;
+	struct lsect	*sp;
+	struct lrel	*rp;
+	struct lpub	*pp;
+
+	if (ver_flag)
+		fprintf(stdout, "   Load    %s\n", mp->mod_fn);
+	if ((fp = fopen(mp->mod_fn, "r")) == NULL)
+		fatal(F_FOPEN, mp->mod_fn);
+	if (fgets(buf, sizeof(buf), fp) == NULL ||
+	    sscanf(buf, RELMAGIC " %d", &vers) != 1 || vers != RELVERS)
+		errx(1, "%s: not a relocatable object", mp->mod_fn);
+	for (ln = 2, done = 0; !done && fgets(buf, sizeof(buf), fp) != NULL;
+	    ln++) {
+		switch (*buf) {
+		case 'S':		/* section */
+			if (sscanf(buf, "S %d %s %x%n", &no, name, &size,
+			    &pos) != 3 || no != (int)mp->mod_nsect + 1 ||
+			    strlen(name) > SYMSIZE || size > IMGSIZE)
+				goto bad;
+			if (mp->mod_nsect == mp->mod_ssect)
+				mp->mod_sect = grow_tab(mp->mod_sect,
+				    &mp->mod_ssect, sizeof(struct lsect));
+			sp = &mp->mod_sect[mp->mod_nsect++];
+			strlcpy(sp->ls_name, name, sizeof(sp->ls_name));
+			sp->ls_size = (int)size;
+			sp->ls_align = 1;
+			sp->ls_mod = mp;
+			for (p = buf + pos; sscanf(p, "%s%n", name, &n) == 1;
+			    p += n) {
+				if (strcmp(name, "B") == 0)
+					sp->ls_bss = 1;
+				else if (*name == 'A' &&
+				    (b = strtoul(name + 1, &ep, 16)) > 0 &&
+				    b <= IMGSIZE / 2 && (b & (b - 1)) == 0 &&
+				    *ep == '\0')
+					sp->ls_align = (int)b;
+				else
+					goto bad;
+			}
+			sp->ls_buf = calloc((size_t)size + 1, 1);
+			sp->ls_set = calloc((size_t)size / 8 + 1, 1);
+			if (sp->ls_buf == NULL || sp->ls_set == NULL)
+				fatal(F_OUTMEM, "objects");
+			break;
+		case 'D':		/* data */
+			if (sscanf(buf, "D %d %x%n", &sect, &off, &pos) != 2 ||
+			    sect < 1 || sect > (int)mp->mod_nsect)
+				goto bad;
+			sp = mod_sect(mp, sect);
+			for (p = buf + pos; ; p = ep, off++) {
+				b = strtoul(p, &ep, 16);
+				if (ep == p)
+					break;
+				if (off >= (unsigned int)sp->ls_size ||
+				    b > 0xff)
+					goto bad;
+				sp->ls_buf[off] = (unsigned char)b;
+				sp->ls_set[off >> 3] |= 1 << (off & 7);
+			}
+			break;
+		case 'X':		/* external symbol */
+			if (sscanf(buf, "X %d %s", &no, name) != 2 ||
+			    no != (int)mp->mod_next + 1 ||
+			    strlen(name) > SYMSIZE)
+				goto bad;
+			if (mp->mod_next == mp->mod_sext)
+				mp->mod_ext = grow_tab(mp->mod_ext,
+				    &mp->mod_sext, sizeof(*mp->mod_ext));
+			strlcpy(mp->mod_ext[mp->mod_next++], name,
+			    sizeof(*mp->mod_ext));
+			break;
+		case 'P':		/* public symbol */
+			if (sscanf(buf, "P %s %d %x", name, &sect, &val) != 3 ||
+			    strlen(name) > SYMSIZE || sect < 0 ||
+			    sect > (int)mp->mod_nsect)
+				goto bad;
+			if (mp->mod_npub == mp->mod_spub)
+				mp->mod_pub = grow_tab(mp->mod_pub,
+				    &mp->mod_spub, sizeof(struct lpub));
+			pp = &mp->mod_pub[mp->mod_npub++];
+			strlcpy(pp->lp_name, name, sizeof(pp->lp_name));
+			pp->lp_sect = sect;
+			pp->lp_val = (int)val;
+			pp->lp_mod = mp;
+			break;
+		case 'R':		/* relocation */
+			if (sscanf(buf, "R %d %x %c %d", &sect, &off, &kind,
+			    &no) != 4 || sect < 1 ||
+			    sect > (int)mp->mod_nsect || off + 1 >=
+			    (unsigned int)mod_sect(mp, sect)->ls_size ||
+			    no < 1 ||
+			    (kind == 'S' && no > (int)mp->mod_nsect) ||
+			    (kind == 'X' && no > (int)mp->mod_next) ||
+			    (kind != 'S' && kind != 'X'))
+				goto bad;
+			if (mp->mod_nrel == mp->mod_srel)
+				mp->mod_rel = grow_tab(mp->mod_rel,
+				    &mp->mod_srel, sizeof(struct lrel));
+			rp = &mp->mod_rel[mp->mod_nrel++];
+			rp->lr_sect = sect;
+			rp->lr_off = (int)off;
+			rp->lr_kind = kind;
+			rp->lr_no = no;
+			break;
+		case 'E':		/* end of object */
+			done = 1;
+			break;
+		default:
+			goto bad;
+		}
+	}
+	fclose(fp);
+	if (!done)
+		errx(1, "%s: truncated object", mp->mod_fn);
+	return;
+bad:
+	errx(1, "%s: bad object, line %zu", mp->mod_fn, ln);
+}
+
+/*
+ *	section no. of an object, counting from 1
+ */
+static struct lsect *
+mod_sect(struct module * const mp, const int no)
+{
+	return (&mp->mod_sect[no - 1]);
+}
+
+/*
+ *	apply the relocations of the live sections of an object
+ */
+static void
+mod_reloc(struct module * const mp)
+{
+	size_t		 i;
+	int		 w, val;
+	struct lrel	*rp;
+	struct lsect	*sp;
+	struct sym	*np;
+
+	for (i = 0; i < mp->mod_nrel; i++) {
+		rp = &mp->mod_rel[i];
+		sp = mod_sect(mp, rp->lr_sect);
+		if (!sp->ls_live)
+			continue;
+		if (rp->lr_kind == 'S')
+			val = mod_sect(mp, rp->lr_no)->ls_base;
+		else {
+			mp->mod_getsym++;
+			np = find_sym(mp->mod_ext[rp->lr_no - 1],
+			    &mp->mod_probes);
+			if (np == NULL) {
+				pthread_mutex_lock(&mod_mtx);
+				fprintf(errfp, "%s: undefined symbol %s\n",
+				    mp->mod_fn, mp->mod_ext[rp->lr_no - 1]);
+				errors++;
+				pthread_mutex_unlock(&mod_mtx);
+				continue;
+			}
+			val = np->sym_val;
+		}
+		w = sp->ls_buf[rp->lr_off] | sp->ls_buf[rp->lr_off + 1] << 8;
+		w += val;
+		sp->ls_buf[rp->lr_off] = w & 0xff;
+		sp->ls_buf[rp->lr_off + 1] = (w >> 8) & 0xff;
+	}
+}
+
+/*
+ *	write the linked image into file fn
+ */
+static void
+img_write(const int origin, const char * const fn)
+{
+	int	end;
+
+	for (end = IMGSIZE; end > origin; end--)
+		if (img_set[end - 1])
+			break;
+	if ((objfp = fopen(fn, "w")) == NULL)
+		fatal(F_FOPEN, fn);
+	obj_image(img_buf, img_set, origin, end);
+	fclose(objfp);
+}
+
+/*
+ *	write the link map into file fn: placement of all sections
+ *	and the public symbols sorted by address
+ */
+static void
+map_write(const char * const fn)
+{
+	FILE		*fp;
+	size_t		 i, j, len;
+	struct lsect	*sp;
+
+	if ((fp = fopen(fn, "w")) == NULL)
+		fatal(F_FOPEN, fn);
+	fprintf(fp, "%-24s %-8s %-4s %-4s\n", "Object", "Section", "Base",
+	    "Size");
+	for (i = 0; i < nmods; i++)
+		for (j = 0; j < mods[i].mod_nsect; j++) {
+			sp = &mods[i].mod_sect[j];
+			if (sp->ls_live)
+				fprintf(fp, "%-24s %-8s %04X %04X\n",
+				    mods[i].mod_fn, sp->ls_name, sp->ls_base,
+				    sp->ls_size);
+			else
+				fprintf(fp, "%-24s %-8s ---- %04X removed\n",
+				    mods[i].mod_fn, sp->ls_name, sp->ls_size);
+		}
+	len = copy_sym();
+	sort_sym(len, 'a');
+	fprintf(fp, "\n%-8s %s\n", "Symbol", "Value");
+	for (i = 0; i < len; i++)
+		fprintf(fp, "%-8s %04X\n", symarray[i]->sym_name,
+		    symarray[i]->sym_val & 0xffff);
+	fclose(fp);
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the performance lint with -W
+ *	the encoded instructions of pass 2 are checked for slow or large
+ *	idioms, and a warning with the bytes and T-states that could be
+ *	saved is printed for each, T-states are counted as the condition
+ *	is met, a shorter but slower instruction is reported with its
+ *	cost in T-states, which isn't subtracted from the T-states saved:
+ *	  - JP, whose target is in range of a JR
+ *	  - LD A,0 and CP 0
+ *	  - PUSH and POP of a register pair not used in between
+ *	  - (IX+d) and (IY+d) in a loop, that could use (HL)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zz80asm.h"
+
+#define PUSHMAX	8		/* max. nesting of PUSH's followed */
+
+/*
+ *	structure pending PUSH's and indexed instructions
+ */
+struct lsite {
+	char	*ls_file;	/* filename */
+	size_t	 ls_line;	/* line no. */
+	int	 ls_pc;		/* address */
+	int	 ls_sect;	/* section of the address */
+	int	 ls_len;	/* bytes saved */
+	int	 ls_cyc;	/* T-states saved */
+	char	 ls_reg[3];	/* register pair of a PUSH */
+	uint8_t	 ls_used;	/* register used, or site reported */
+};
+
+/*
+ *	structure files with warnings
+ */
+struct lfile {
+	char	*lf_name;	/* filename */
+	int	 lf_count;	/* no. of warnings */
+	int	 lf_len;	/* bytes saved */
+	int	 lf_cyc;	/* T-states saved */
+	int	 lf_cost;	/* T-states lost for bytes saved */
+};
+
+static void	 lint_warn(const char * const, const size_t, const char * const,
+		    const int, const int);
+static void	 lint_pupo(const struct opc * const, const int);
+static void	 lint_loop(const int);
+static int	 lint_uses(const char * const);
+static int	 lint_cyc(const int * const, const int);
+
+static struct lsite	 pushes[PUSHMAX];	/* pending PUSH's */
+static int		 npushes;		/* no. of pending PUSH's */
+static struct lsite	*idxs;			/* indexed instructions */
+static size_t		 nidxs, sidxs;		/* no. and size of idxs */
+static struct lfile	*files;			/* files with warnings */
+static size_t		 nfiles, sfiles;	/* no. and size of files */
+
+/*
+ *	check the instruction encoded in ops[] of this line
+ *
+ *	Input: opcode table entry, NULL for a line without opcode,
+ *	       length of the instruction
+ */
+void
+lint_line(const struct opc * const op, const int n)
+{
+	int		 i, d, c, hl[3];
+	struct lsite	*sp;
+
+	if (op == NULL) {
+		if (*label)		/* jump target between PUSH and POP */
+			npushes = 0;
+		return;
+	}
+	lint_pupo(op, n);
+	if (n == 0)
+		return;
+	c = ops[0] & 0xff;
+	if (op->op_fun == op_jp && n == 3 && (c == 0xc3 || c == 0xc2 ||
+	    c == 0xca || c == 0xd2 || c == 0xda) && !ev_ext &&
+	    ev_sect == cursect) {
+		d = ((ops[1] & 0xff) | (ops[2] & 0xff) << 8) - (pc + 2);
+		if (d >= -128 && d <= 127) {
+			hl[0] = (c == 0xc3) ? 0x18 : (c & 0x18) | 0x20;
+			hl[1] = d;
+			lint_warn(srcfn, c_line, "JP could be JR", 1,
+			    lint_cyc(ops, 3) - lint_cyc(hl, 2));
+		}
+		if (d < 0)
+			lint_loop(d + pc + 2);
+	} else if ((op->op_fun == op_jr || op->op_fun == op_djnz) &&
+	    n == 2 && (ops[1] & 0x80))
+		lint_loop(pc + 2 + (ops[1] & 0xff) - 256);
+	else if (op->op_fun == op_ld && n == 2 && c == 0x3e &&
+	    ops[1] == 0 && !ev_sect && !ev_ext)
+		lint_warn(srcfn, c_line, "LD A,0 could be XOR A", 1, 3);
+	else if (op->op_fun == op_cp && n == 2 && c == 0xfe &&
+	    ops[1] == 0 && !ev_sect && !ev_ext)
+		lint_warn(srcfn, c_line, "CP 0 could be OR A", 1, 3);
+	else if ((c == 0xdd || c == 0xfd) && n >= 3 &&
+	    (strstr(operand, "(IX") || strstr(operand, "(IY"))) {
+		if ((ops[1] & 0xff) == 0xcb) {
+			hl[0] = 0xcb;		/* DD CB d op */
+			hl[1] = ops[3];
+			i = 2;
+		} else {
+			hl[0] = ops[1];		/* DD op d [n] */
+			hl[1] = ops[3];
+			i = n - 2;
+		}
+		if (nidxs == sidxs)
+			idxs = grow_tab(idxs, &sidxs, sizeof(struct lsite));
+		sp = &idxs[nidxs++];
+		if ((sp->ls_file = strdup(srcfn)) == NULL)
+			fatal(F_OUTMEM, "lint");
+		sp->ls_line = c_line;
+		sp->ls_pc = pc;
+		sp->ls_sect = cursect;
+		sp->ls_len = 2;
+		sp->ls_cyc = lint_cyc(ops, n) - lint_cyc(hl, i);
+		sp->ls_used = 0;
+	}
+}
+
+/*
+ *	print the summary of the warnings for each file
+ */
+void
+lint_end(void)
+{
+	size_t	i;
+
+	for (i = 0; i < nfiles; i++) {
+		fprintf(errfp, "%s: %d warning(s), %d byte(s) and "
+		    "%d T-state(s) could be saved", files[i].lf_name,
+		    files[i].lf_count, files[i].lf_len, files[i].lf_cyc);
+		if (files[i].lf_cost)
+			fprintf(errfp, ", at a cost of %d T-state(s)",
+			    files[i].lf_cost);
+		fprintf(errfp, "\n");
+	}
+}
+
+/*
+ *	print a warning and add it to the summary of the file
+ */
+static void
+lint_warn(const char * const fn, const size_t ln, const char * const msg,
+    const int len, const int cyc)
+{
+	size_t		 i;
+	struct lfile	*fp;
+
+	fprintf(errfp, "Warning in file: %s Line: %zu\n", fn, ln);
+	if (cyc < 0)
+		fprintf(errfp, "%s: %d byte(s), slower by %d T-state(s)\n",
+		    msg, len, -cyc);
+	else
+		fprintf(errfp, "%s: %d byte(s), %d T-state(s)\n", msg, len,
+		    cyc);
+	for (i = 0; i < nfiles; i++)
+		if (strcmp(files[i].lf_name, fn) == 0)
+			break;
+	if (i == nfiles) {
+		if (nfiles == sfiles)
+			files = grow_tab(files, &sfiles, sizeof(struct lfile));
+		fp = &files[nfiles++];
+		if ((fp->lf_name = strdup(fn)) == NULL)
+			fatal(F_OUTMEM, "lint");
+		fp->lf_count = fp->lf_len = fp->lf_cyc = fp->lf_cost = 0;
+	}
+	fp = &files[i];
+	fp->lf_count++;
+	fp->lf_len += len;
+	if (cyc < 0)
+		fp->lf_cost -= cyc;
+	else
+		fp->lf_cyc += cyc;
+}
+
+/*
+ *	follow PUSH's in straight code up to the POP of the same
+ *	register pair, and check if the pair is used in between
+ */
+static void
+lint_pupo(const struct opc * const op, const int n)
+{
+	int		 i;
+	struct lsite	*sp;
+
+	if (*label || n == 0 || op->op_fun == op_jp || op->op_fun == op_jr ||
+	    op->op_fun == op_djnz || op->op_fun == op_call ||
+	    op->op_fun == op_ret || op->op_fun == op_rst ||
+	    op->op_fun == op_ex || op->op_fun == op_2b ||
+	    (op->op_fun == op_1b && op->op_c1 == 0xd9) ||	/* EXX */
+	    op->op_fun == op_db || op->op_fun == op_dw ||
+	    op->op_fun == op_dm || op->op_fun == op_ds) {
+		npushes = 0;
+		return;
+	}
+	if (op->op_fun != op_pupo) {
+		for (i = 0; i < npushes; i++)
+			if (lint_uses(pushes[i].ls_reg))
+				pushes[i].ls_used = 1;
+		return;
+	}
+	if (op->op_c1 == 2) {				/* PUSH */
+		if (npushes == PUSHMAX || strlen(operand) != 2 ||
+		    strcmp(operand, "AF") == 0) {
+			npushes = 0;
+			return;
+		}
+		sp = &pushes[npushes++];
+		free(sp->ls_file);
+		if ((sp->ls_file = strdup(srcfn)) == NULL)
+			fatal(F_OUTMEM, "lint");
+		sp->ls_line = c_line;
+		sp->ls_len = n;
+		sp->ls_cyc = lint_cyc(ops, n);
+		strlcpy(sp->ls_reg, operand, sizeof(sp->ls_reg));
+		sp->ls_used = 0;
+		return;
+	}
+	if (npushes == 0)				/* POP */
+		return;
+	sp = &pushes[--npushes];
+	if (strcmp(sp->ls_reg, operand) != 0) {
+		npushes = 0;
+		return;
+	}
+	if (!sp->ls_used)
+		lint_warn(sp->ls_file, sp->ls_line, "PUSH and POP of unused "
+		    "register pair", sp->ls_len + n,
+		    sp->ls_cyc + lint_cyc(ops, n));
+	for (i = 0; i < npushes; i++)	/* POP uses the pair for the others */
+		if (lint_uses(pushes[i].ls_reg))
+			pushes[i].ls_used = 1;
+}
+
+/*
+ *	report the indexed instructions in the loop from address target
+ *	up to the backward jump at pc
+ */
+static void
+lint_loop(const int target)
+{
+	size_t		 i, j;
+	struct lsite	*sp;
+
+	for (i = nidxs; i > 0; i--) {
+		sp = &idxs[i - 1];
+		if (sp->ls_sect == cursect && sp->ls_pc < target)
+			break;
+	}
+	for (j = i; j < nidxs; j++) {
+		sp = &idxs[j];
+		if (sp->ls_sect != cursect || sp->ls_used)
+			continue;
+		sp->ls_used = 1;
+		lint_warn(sp->ls_file, sp->ls_line,
+		    "(IX+d)/(IY+d) in a loop could be (HL)", sp->ls_len,
+		    sp->ls_cyc);
+	}
+}
+
+/*
+ *	check if the operand of this line uses a register pair
+ *	or one of its halves
+ */
+static int
+lint_uses(const char * const reg)
+{
+	char		 word[LINE_MAX], *w;
+	const char	*p;
+
+	for (p = operand; *p; ) {
+		for (w = word; *p && strchr("(),+-", *p) == NULL; )
+			*w++ = *p++;
+		*w = '\0';
+		if (*p)
+			p++;
+		if (strcmp(word, reg) == 0 || strcmp(word, "SP") == 0 ||
+		    (reg[0] != 'I' && ((word[0] == reg[0] ||
+		    word[0] == reg[1]) && word[1] == '\0')) ||
+		    (reg[0] == 'I' && strncmp(word, reg, 2) == 0))
+			return (1);
+	}
+	return (0);
+}
+
+/*
+ *	T-states of an instruction, as the condition is met
+ */
+static int
+lint_cyc(const int * const op, const int n)
+{
+	int	alt;
+
+	return (cyc_count(op, (size_t)n, &alt));
+}
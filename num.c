@@ -53,15 +53,25 @@ enum {
 	OPESYM = 99		/* symbol */
 };
 
+static int 	expr(const char *, int * const, int * const);
 static int 	strval(const char *);
 static int 	isari(const int);
 static int 	get_type(const char * const);
+static void	rel_err(void);
+static void	ev_err(enum err_type);
 static int 	axtoi(const char *);
 static int 	abtoi(const char *);
 static int 	aotoi(const char *);
 
+int	ev_sect;		/* section of last expression */
+int	ev_ext;			/* external symbol of last expression */
+int	ev_pend;		/* relocatable values not yet output */
+int	ev_late;		/* last expression depends on placement */
+static int	ev_quiet;		/* don't report errors in expressions */
+
 /*
- *	recursive expression parser
+ *	evaluate expression, the section and external symbol the value
+ *	is relative to are left in ev_sect and ev_ext
  *
  *	Input: pointer to argument rest string
  *
@@ -69,34 +79,110 @@ static int 	aotoi(const char *);
  */
 int
 eval(const char *s)
+{
+	int	val;
+
+	perf.pf_eval++;
+	ev_late = 0;
+	val = expr(s, &ev_sect, &ev_ext);
+	if (ev_sect || ev_ext)
+		ev_pend++;
+	return (val);
+}
+
+/*
+ *	evaluate expression, whose value must be known in pass 1
+ *	and can't depend on the placement of sections
+ */
+int
+eval_fixed(const char *s)
+{
+	int	val;
+
+	val = eval(s);
+	if (ev_late || (ev_sect && out_form != OUTREL))
+		asmerr(E_ILLREL);
+	return (val);
+}
+
+/*
+ *	evaluate expression without reporting errors, ev_late is set
+ *	if the value can't be computed
+ */
+int
+eval_quiet(const char *s)
+{
+	int	val;
+
+	ev_quiet = 1;
+	val = eval(s);
+	ev_quiet = 0;
+	return (val);
+}
+
+/*
+ *	evaluate target of a relative jump
+ *	the distance to pc is absolute if the target is in the same section
+ *
+ *	Output: distance of target to pc
+ */
+int
+eval_pc(const char *s)
+{
+	int	val;
+
+	perf.pf_eval++;
+	ev_late = 0;
+	val = expr(s, &ev_sect, &ev_ext);
+	if (ev_ext || ev_sect != cursect)
+		asmerr(E_ILLREL);
+	return (val - pc);
+}
+
+/*
+ *	recursive expression parser
+ *	only the sum of a relocatable or external value and absolute
+ *	values, or the difference of two values in the same section,
+ *	are relocatable, everything else is an error
+ *
+ *	Input: pointer to argument rest string
+ *	       pointers for section and external symbol of the value
+ *
+ *	Output: computed value
+ */
+static int
+expr(const char *s, int * const sect, int * const ext)
 {
 	char           *p;
-	int 		val;
+	int 		val, s2, x2;
 	char 		word[LINE_MAX];
 	struct sym     *sp;
 
+	if (++perf.pf_depth > perf.pf_maxdepth)
+		perf.pf_maxdepth = perf.pf_depth;
 	val = 0;
+	*sect = *ext = 0;
 	while (*s) {
 		p = word;
 		if (*s == '(') {
 			s++;
 			while (*s != ')') {
 				if (*s == '\0') {
-					asmerr(E_MISPAR);
+					ev_err(E_MISPAR);
 					goto eval_break;
 				}
 				*p++ = *s++;
 			}
 			*p = '\0';
 			s++;
-			val = eval(word);
+			val = expr(word, sect, ext);
 			continue;
 		}
 		if (*s == STRSEP) {
 			s++;
 			while (*s != STRSEP) {
 				if (*s == '\n' || *s == '\0') {
-					asmerr(E_MISHYP);
+					ev_err(E_MISHYP);
 					goto hyp_error;
 				}
 				*p++ = *s++;
@@ -117,14 +203,17 @@ hyp_error:
 		case OPESYM:			/* symbol */
 			if (strcmp(word, "$") == 0) {
 				val = pc;
+				*sect = cursect;
 				break;
 			}
 			if (strlen(word) > SYMSIZE)
 				word[SYMSIZE] = '\0';
-			if ((sp = get_sym(word)) != NULL)
+			if ((sp = get_sym(word)) != NULL) {
 				val = sp->sym_val;
-			else
-				asmerr(E_UNDSYM);
+				*sect = sp->sym_sect;
+				*ext = sp->sym_ext;
+			} else
+				ev_err(E_UNDSYM);
 			break;
 		case OPEDEC:			/* decimal number */
 			val = atoi(word);
@@ -139,44 +228,88 @@ hyp_error:
 			val = aotoi(word);
 			break;
 		case OPESUB:			/* arithmetical - */
-			val -= eval(s);
+			val -= expr(s, &s2, &x2);
+			if (x2 || (s2 && s2 != *sect))
+				rel_err();
+			else if (s2)		/* distance in a section */
+				*sect = 0;
 			goto eval_break;
 		case OPEADD:			/* arithmetical + */
-			val += eval(s);
+			val += expr(s, &s2, &x2);
+			if ((*sect || *ext) && (s2 || x2))
+				rel_err();
+			if (s2)
+				*sect = s2;
+			if (x2)
+				*ext = x2;
 			goto eval_break;
 		case OPEMUL:			/* arithmetical * */
-			val *= eval(s);
-			goto eval_break;
+			val *= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPEDIV:			/* arithmetical / */
-			val /= eval(s);
-			goto eval_break;
+			val /= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPEMOD:			/* arithmetical modulo */
-			val %= eval(s);
-			goto eval_break;
+			val %= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPESHL:			/* logical shift left */
-			val <<= eval(s);
-			goto eval_break;
+			val <<= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPESHR:			/* logical shift right */
-			val >>= eval(s);
-			goto eval_break;
+			val >>= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPELOR:			/* logical OR */
-			val |= eval(s);
-			goto eval_break;
+			val |= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPELAN:			/* logical AND */
-			val &= eval(s);
-			goto eval_break;
+			val &= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPEXOR:			/* logical XOR */
-			val ^= eval(s);
-			goto eval_break;
+			val ^= expr(s, &s2, &x2);
+			goto eval_rel;
 		case OPECOM:			/* logical complement */
-			val = ~(eval(s));
-			goto eval_break;
+			val = ~(expr(s, &s2, &x2));
+			goto eval_rel;
 		}
 	}
 eval_break:
+	perf.pf_depth--;
+	return (val);
+eval_rel:			/* no arithmetic on relocatable values */
+	if (*sect || *ext || s2 || x2)
+		rel_err();
+	*sect = *ext = 0;
+	perf.pf_depth--;
 	return (val);
 }
 
+/*
+ *	illegal use of a relocatable value, unless it is relative to
+ *	a section not yet placed in pass 1, then the value is only
+ *	known after the placement
+ */
+static void
+rel_err(void)
+{
+	if (out_form == OUTREL)
+		ev_err(E_ILLREL);
+	else
+		ev_late = 1;
+}
+
+/*
+ *	report an error in an expression, or only mark the value
+ *	as unknown for eval_quiet()
+ */
+static void
+ev_err(enum err_type et)
+{
+	if (ev_quiet)
+		ev_late = 1;
+	else
+		asmerr(et);
+}
+
 /*
  *	get type of operand
  *
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the peephole optimizer with -O
+ *	instructions are rewritten after they were encoded:
+ *	  - LD A,0 becomes XOR A, if the next instruction sets all flags
+ *	  - CP 0 becomes OR A
+ *	  - LD r,r is removed
+ *	  - CALL nn followed by RET becomes JP nn, the RET is removed
+ *	  - JP and JR to the next instruction are removed
+ *	rewrites that depend on the next line or the layout are sites,
+ *	decided in pass 1 and repeated in pass 2; pass 1 is repeated
+ *	while sites are shortened; a removed jump whose target moves
+ *	away, e.g. behind an ALIGN, is restored and never removed again
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zz80asm.h"
+
+#define P_LDA0	1		/* LD A,0 */
+#define P_CALL	2		/* CALL nn */
+#define P_JPNX	3		/* JP or JR nn */
+
+/*
+ *	structure peephole sites
+ */
+struct peep {
+	char	*pe_arg;	/* target of a jump */
+	int	 pe_pc;		/* address in last pass 1 */
+	int	 pe_sect;	/* section of the address */
+	int	 pe_len;	/* length of the jump */
+	size_t	 pe_line;	/* line no. of the instruction */
+	uint8_t	 pe_rule;	/* P_xxx */
+	uint8_t	 pe_dead;	/* flags are set by the next instruction */
+	uint8_t	 pe_done;	/* instruction is rewritten */
+	uint8_t	 pe_keep;	/* jump was restored, keep it */
+};
+
+static int		opt_number(const char * const);
+static int		opt_dead(const struct opc * const);
+static struct peep     *opt_site(const int);
+
+uint8_t			opt_mark;	/* line is rewritten, for listing */
+
+static struct peep     *peeps;		/* sites in source order */
+static size_t		npeeps, speeps;	/* no. and size of sites */
+static size_t		curpeep;	/* next site in this pass */
+static struct peep     *prev;		/* site of the last instruction */
+static uint8_t		opt_on;		/* region not excluded by NOOPT */
+
+/*
+ *	start a pass at the first site
+ */
+void
+opt_init(void)
+{
+	curpeep = 0;
+	prev = NULL;
+	opt_on = 1;
+}
+
+/*
+ *	OPT and NOOPT
+ */
+void
+opt_set(const int on)
+{
+	opt_on = on;
+}
+
+/*
+ *	encode the instruction of this line, and rewrite it if possible
+ *
+ *	Input: opcode table entry
+ *
+ *	Output: length of the instruction
+ */
+int
+opt_line(const struct opc * const op)
+{
+	struct peep	*pp, *last;
+	int		 n;
+
+	opt_mark = 0;
+	last = prev;
+	prev = NULL;
+	if (last != NULL && last->pe_line + 1 != c_line)
+		last = NULL;
+	if (!opt_flag || !opt_on)
+		return ((*op->op_fun)(op->op_c1, op->op_c2));
+	if (last != NULL && pass == 1 && last->pe_rule == P_LDA0 &&
+	    opt_dead(op))
+		last->pe_dead = 1;
+	if (op->op_fun == op_ld && strncmp(operand, "A,", 2) == 0 &&
+	    opt_number(operand + 2)) {
+		pp = prev = opt_site(P_LDA0);
+		n = (*op->op_fun)(op->op_c1, op->op_c2);
+		if (!pp->pe_done)
+			return (n);
+		ops[0] = 0xaf;			/* XOR A */
+		opt_mark = 1;
+		return (1);
+	}
+	if (op->op_fun == op_ld && strlen(operand) == 3 &&
+	    operand[1] == ',' && operand[0] == operand[2] &&
+	    strchr("ABCDEHL", operand[0]) != NULL) {
+		(*op->op_fun)(op->op_c1, op->op_c2);
+		opt_mark = 1;
+		return (0);
+	}
+	if (op->op_fun == op_cp && opt_number(operand)) {
+		(*op->op_fun)(op->op_c1, op->op_c2);
+		ops[0] = 0xb7;			/* OR A */
+		opt_mark = 1;
+		return (1);
+	}
+	if (op->op_fun == op_call && *operand && !strchr(operand, ',')) {
+		pp = prev = opt_site(P_CALL);
+		n = (*op->op_fun)(op->op_c1, op->op_c2);
+		if (pp->pe_done) {
+			ops[0] = 0xc3;		/* JP nn */
+			opt_mark = 1;
+		}
+		return (n);
+	}
+	if (op->op_fun == op_ret && last != NULL && last->pe_rule == P_CALL &&
+	    *operand == '\0' && *label == '\0') {
+		(*op->op_fun)(op->op_c1, op->op_c2);
+		if (pass == 1)
+			last->pe_done = 1;
+		opt_mark = 1;
+		return (0);
+	}
+	if ((op->op_fun == op_jp || op->op_fun == op_jr) && *operand &&
+	    *operand != '(' && !strchr(operand, ',')) {
+		pp = opt_site(P_JPNX);
+		if (pp->pe_done) {
+			if (pass == 1 && *label)
+				put_label();
+			if (relax_flag)		/* keep the sites of -j */
+				rlx_long(operand);
+			opt_mark = 1;
+			return (0);
+		}
+		n = (*op->op_fun)(op->op_c1, op->op_c2);
+		pp->pe_len = n;
+		return (n);
+	}
+	return ((*op->op_fun)(op->op_c1, op->op_c2));
+}
+
+/*
+ *	after pass 1, rewrite the sites that turned out to be possible
+ *
+ *	Output: no. of sites changed
+ */
+int
+opt_check(void)
+{
+	size_t		 i;
+	int		 n, ok, val, savepc, savesect;
+	struct peep	*pp;
+
+	savepc = pc;
+	savesect = cursect;
+	for (n = 0, i = 0; i < npeeps; i++) {
+		pp = &peeps[i];
+		if (pp->pe_rule == P_JPNX && !pp->pe_keep) {
+			pc = pp->pe_pc;
+			cursect = pp->pe_sect;
+			val = eval_quiet(pp->pe_arg);
+			ok = !ev_late && !ev_ext && ev_sect == cursect;
+			if (pp->pe_done && (!ok || val != pc)) {
+				pp->pe_done = 0;	/* target moved */
+				pp->pe_keep = 1;
+				n++;
+			} else if (!pp->pe_done) {
+				pp->pe_done = ok && val == pc + pp->pe_len;
+				n += pp->pe_done;
+			}
+		} else if (pp->pe_rule == P_LDA0 && !pp->pe_done) {
+			pp->pe_done = pp->pe_dead;
+			n += pp->pe_done;
+		}
+	}
+	pc = savepc;
+	cursect = savesect;
+	if (ver_flag && n)
+		fprintf(stdout, "   Peephole %d instruction(s) changed\n", n);
+	return (n);
+}
+
+/*
+ *	next site: in pass 1 its address and target are kept, a site
+ *	of another rule after a change of conditional assembly starts
+ *	over
+ *
+ *	Input: rule of the site
+ *
+ *	Output: pointer to the site
+ */
+static struct peep *
+opt_site(const int rule)
+{
+	struct peep	*pp;
+
+	if (curpeep == npeeps) {
+		if (pass == 2)
+			fatal(F_INTERN, "peephole site missing in pass 1");
+		if (npeeps == speeps)
+			peeps = grow_tab(peeps, &speeps, sizeof(struct peep));
+		pp = &peeps[npeeps++];
+		pp->pe_arg = NULL;
+		pp->pe_rule = 0;
+	}
+	pp = &peeps[curpeep++];
+	if (pass == 2) {
+		if (pp->pe_rule != rule)
+			fatal(F_INTERN, "peephole site changed in pass 2");
+		return (pp);
+	}
+	if (pp->pe_rule != rule || rule == P_CALL) {
+		pp->pe_rule = rule;
+		pp->pe_dead = 0;
+		pp->pe_done = 0;
+		pp->pe_keep = 0;
+	}
+	if (rule == P_JPNX) {
+		free(pp->pe_arg);
+		if ((pp->pe_arg = strdup(operand)) == NULL)
+			fatal(F_OUTMEM, "peephole sites");
+	}
+	pp->pe_pc = pc;
+	pp->pe_sect = cursect;
+	pp->pe_line = c_line;
+	return (pp);
+}
+
+/*
+ *	check if an operand is a number of value 0, without symbols
+ *	to have the same value in all passes
+ */
+static int
+opt_number(const char * const s)
+{
+	if (!isdigit((unsigned char)*s) ||
+	    s[strspn(s, "0123456789ABCDEFHOQ")] != '\0')
+		return (0);
+	return (eval_quiet(s) == 0 && !ev_late);
+}
+
+/*
+ *	check if an instruction sets all flags without using them
+ */
+static int
+opt_dead(const struct opc * const op)
+{
+	return (op->op_fun == op_and || op->op_fun == op_or ||
+	    op->op_fun == op_xor || op->op_fun == op_cp ||
+	    op->op_fun == op_sub ||
+	    (op->op_fun == op_add && strncmp(operand, "A,", 2) == 0));
+}
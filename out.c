@@ -25,6 +25,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "zz80asm.h"
@@ -34,6 +35,10 @@ extern const char *__progname;
 static void	flush_hex(void);
 static int	chksum(void);
 static void	btoh(const unsigned char, char ** const);
+static void	dep_name(FILE * const, const char *);
+static void	obj_start(void);
+static void	obj_stop(void);
+static void	rel_write(void);
 
 static char	*errmsg[] = {		/* error messages for asmerr() */
 	"illegal opcode",		/* 0 */
@@ -46,9 +51,18 @@ static char	*errmsg[] = {		/* error messages for asmerr() */
 	"missing string separator",	/* 7 */
 	"memory override",		/* 8 */
 	"missing IF",			/* 9 */
-	"IF nesting to deep",		/* 10 */
-	"missing ENDIF",		/* 11 */
-	"INCLUDE nesting to deep"	/* 12 */
+	"missing ENDIF",		/* 10 */
+	"recursive INCLUDE",		/* 11 */
+	"illegal relocation",		/* 12 */
+	"illegal ORG",			/* 13 */
+	"data in BSS section",		/* 14 */
+	"page crossed",			/* 15 */
+	"not aligned",			/* 16 */
+	"unmatched NOCROSS/ENDCROSS",	/* 17 */
+	"T-states out of budget",	/* 18 */
+	"missing UTEST",		/* 19 */
+	"test failed",			/* 20 */
+	"opcode not in instruction set of CPU"	/* 21 */
 };
 
 #define MAXHEX 255			/* max num of bytes per hex record */
@@ -63,6 +77,30 @@ static unsigned	char hex_buf[MAXHEX];	/* buffer for one hex record */
 static char	hex_out[MAXHEX * 2 + 11]; /* ASCII buffer for one hex record */
 
 static int	errnum = 0;		/* error number in pass 2 */
+static char	errarg[32];		/* addresses for error message */
+
+#define OBJSIZE	65536			/* size of Z80 address space */
+#define RELDATA	32			/* bytes per data record */
+
+/*
+ *	structure relocations of relocatable object
+ */
+struct rel {
+	int	rel_in;		/* section of the word */
+	int	rel_off;	/* offset of word in section */
+	int	rel_sect;	/* section the word is relative to, or 0 */
+	int	rel_ext;	/* external symbol relative to, or 0 */
+};
+
+static int	     obj_mem;		/* object is buffered until the end */
+static unsigned char obj_buf[OBJSIZE];	/* buffered object */
+static unsigned char obj_set[OBJSIZE];	/* bytes of obj_buf written */
+static struct rel   *reltab;		/* relocations */
+static size_t	     relcnt, relsize;	/* no. and size of relocations */
+static char	   **exttab;		/* names of external symbols */
+static size_t	     extcnt, extsize;	/* no. and size of external symbols */
+static struct sym  **pubtab;		/* public symbols */
+static size_t	     pubcnt, pubsize;	/* no. and size of public symbols */
 
 /*
  *	print error message to listfile and increase error counter
@@ -72,12 +110,39 @@ asmerr(enum err_type et)
 {
 	if (pass == 1) {
 		fprintf(errfp, "Error in file: %s Line: %zu\n", srcfn, c_line);
-		fprintf(errfp, "%s\n", errmsg[et]);
+		fprintf(errfp, "%s%s\n", errmsg[et], errarg);
+		*errarg = '\0';
 	} else
 		errnum = et;
 	errors++;
 }
 
+/*
+ *	print error message with the offending addresses from
+ *	a up to b to listfile and increase error counter
+ */
+void
+asmerr_adr(enum err_type et, const int a, const int b)
+{
+	snprintf(errarg, sizeof(errarg), ": %04X-%04X", a & 0xffff,
+	    b & 0xffff);
+	asmerr(et);
+}
+
+/*
+ *	print error message with explanation arg for line no. ln of
+ *	file fn, found after the line was processed,
+ *	and increase error counter
+ */
+void
+asmerr_at(enum err_type et, const char * const fn, const size_t ln,
+    const char * const arg)
+{
+	fprintf(errfp, "Error in file: %s Line: %zu\n", fn, ln);
+	fprintf(errfp, "%s: %s\n", errmsg[et], arg);
+	errors++;
+}
+
 /*
  *	begin new page in listfile
  */
@@ -99,7 +164,9 @@ lst_header(void)
 void
 lst_attl(void)
 {
-	fprintf(lstfp, "\nLOC   OBJECT CODE   LINE   STMT SOURCE CODE\n");
+	fprintf(lstfp, "\nLOC   OBJECT CODE   %s%sLINE   STMT SOURCE CODE\n",
+	    cyc_flag ? "CYC    SUM   " : "",
+	    prof_flag ? "     COUNT       CYCLES " : "");
 	p_line += 2;
 }
 
@@ -113,6 +180,7 @@ lst_line(const int val, int opanz)
 
 	if (!list_flag || sd_flag == 4) {
 		sd_flag = 0;
+		opt_mark = 0;
 		return;
 	}
 	if ((ppl != 0) && ((p_line >= ppl) || (c_line == 1))) {
@@ -150,16 +218,24 @@ lst_line(const int val, int opanz)
 		fprintf(lstfp, "   ");
 	if (opanz >= 4)
 		fprintf(lstfp, "%02X ", ops[3] & 0xff);
+	else if (opt_mark)		/* rewritten by -O */
+		fprintf(lstfp, "*  ");
 	else
 		fprintf(lstfp, "   ");
 no_data:
+	if (cyc_flag)
+		fputs(cyc_list(), lstfp);
+	if (prof_flag)
+		fputs(prof_list(), lstfp);
 	fprintf(lstfp, "%6zu %6zu %s", c_line, s_line, line);
 	if (errnum) {
-		fprintf(errfp, "=> %s\n", errmsg[errnum]);
+		fprintf(errfp, "=> %s%s\n", errmsg[errnum], errarg);
 		errnum = 0;
+		*errarg = '\0';
 		p_line++;
 	}
 	sd_flag = 0;
+	opt_mark = 0;
 	p_line++;
 	if (opanz > 4 && sd_flag == 0) {
 		opanz -= 4;
@@ -189,6 +265,8 @@ no_data:
 				fprintf(lstfp, "%02X ", ops[i++] & 0xff);
 			else
 				fprintf(lstfp, "   ");
+			if (cyc_flag)
+				fputs(cyc_list(), lstfp);
 			fprintf(lstfp, "%6zu %6zu\n", c_line, s_line);
 			p_line++;
 		}
@@ -225,10 +303,71 @@ lst_sort_sym(const size_t len)
 }
 
 /*
- *	write header record into object file
+ *	write header record into object file, a relocatable object or
+ *	sections are buffered and written at the end
  */
 void
 obj_header(void)
+{
+	obj_mem = out_form == OUTREL || sect_get(1) != NULL;
+	if (!obj_mem)
+		obj_start();
+}
+
+/*
+ *	write end record into object file
+ */
+void
+obj_end(void)
+{
+	int	start, end;
+
+	if (out_form == OUTREL)
+		rel_write();
+	else if (obj_mem) {
+		for (start = 0; start < OBJSIZE && !obj_set[start]; start++)
+			;
+		for (end = OBJSIZE; end > start && !obj_set[end - 1]; end--)
+			;
+		if (start == end)
+			start = end = prg_adr;
+		obj_image(obj_buf, obj_set, start, end);
+	} else
+		obj_stop();
+}
+
+/*
+ *	write memory image into object file, from address start
+ *	up to address end, bytes not set are filled
+ */
+void
+obj_image(const unsigned char * const buf, const unsigned char * const set,
+    const int start, const int end)
+{
+	int	a, n;
+
+	obj_mem = 0;
+	prg_adr = start;
+	obj_start();
+	for (a = start; a < end;) {
+		if (!set[a]) {
+			for (n = 0; a < end && !set[a]; n++)
+				a++;
+			obj_fill(n);
+			continue;
+		}
+		for (n = 0; a < end && n < OPCARRAY && set[a]; n++)
+			ops[n] = buf[a++];
+		obj_writeb((size_t)n);
+	}
+	obj_stop();
+}
+
+/*
+ *	write header record of an object written as a stream
+ */
+static void
+obj_start(void)
 {
 	switch (out_form) {
 	case OUTBIN:
@@ -245,10 +384,10 @@ obj_header(void)
 }
 
 /*
- *	write end record into object file
+ *	write end record of an object written as a stream
  */
-void
-obj_end(void)
+static void
+obj_stop(void)
 {
 	switch (out_form) {
 	case OUTBIN:
@@ -267,12 +406,26 @@ obj_end(void)
 void
 obj_writeb(size_t opanz)
 {
-	int	i;
+	int	i, a;
 
+	if (test_flag && !obj_mem && !sect_bss())	/* image for -u */
+		for (i = 0; i < (int)opanz; i++)
+			obj_buf[(pc + i) & 0xffff] = (unsigned char)ops[i];
+	if (obj_mem) {
+		if (sect_bss())
+			return;
+		for (i = 0; opanz; opanz--) {
+			a = sect_addr(pc + i);
+			obj_buf[a] = (unsigned char)ops[i++];
+			obj_set[a] = 1;
+		}
+		return;
+	}
 	switch (out_form) {
 	case OUTBIN:
 	case OUTMOS:
-		fwrite(ops, 1, opanz, objfp);
+		for (i = 0; opanz; opanz--)	/* ops[] holds int's */
+			putc(ops[i++] & 0xff, objfp);
 		break;
 	case OUTHEX:
 		for (i = 0; opanz; opanz--) {
@@ -286,10 +439,22 @@ obj_writeb(size_t opanz)
 
 /*
  *	write <count> bytes 0xff into object file
+ *	unwritten bytes of a relocatable object are left to the linker
  */
 void
 obj_fill(int count)
 {
+	int	a;
+
+	if (obj_mem) {
+		if (out_form == OUTHEX || out_form == OUTREL || sect_bss())
+			return;
+		for (a = pc; count > 0; count--, a++) {
+			obj_buf[sect_addr(a)] = 0xff;
+			obj_set[sect_addr(a)] = 1;
+		}
+		return;
+	}
 	switch (out_form) {
 	case OUTBIN:
 	case OUTMOS:
@@ -303,6 +468,126 @@ obj_fill(int count)
 	}
 }
 
+/*
+ *	record a relocation for the word at offset off in ops[],
+ *	if the value of the last expression is relocatable
+ */
+void
+obj_reloc(const int off)
+{
+	if (out_form != OUTREL || (!ev_sect && !ev_ext))
+		return;
+	ev_pend--;
+	if (relcnt == relsize)
+		reltab = grow_tab(reltab, &relsize, sizeof(struct rel));
+	reltab[relcnt].rel_in = cursect;
+	reltab[relcnt].rel_off = (pc + off) & 0xffff;
+	reltab[relcnt].rel_sect = ev_sect;
+	reltab[relcnt].rel_ext = ev_ext;
+	relcnt++;
+}
+
+/*
+ *	add an external symbol to the relocatable object
+ *
+ *	Output: no. of the external symbol, counting from 1
+ */
+int
+obj_extern(const char * const name)
+{
+	if (extcnt == extsize)
+		exttab = grow_tab(exttab, &extsize, sizeof(char *));
+	if ((exttab[extcnt] = strdup(name)) == NULL)
+		fatal(F_OUTMEM, "external symbols");
+	return ((int)++extcnt);
+}
+
+/*
+ *	add a public symbol to the relocatable object
+ */
+void
+obj_public(struct sym * const sp)
+{
+	size_t	i;
+
+	for (i = 0; i < pubcnt; i++)
+		if (pubtab[i] == sp)
+			return;
+	if (pubcnt == pubsize)
+		pubtab = grow_tab(pubtab, &pubsize, sizeof(struct sym *));
+	pubtab[pubcnt++] = sp;
+}
+
+/*
+ *	memory image of the program, for the tests of -u
+ */
+const unsigned char *
+obj_memory(void)
+{
+	return (obj_buf);
+}
+
+/*
+ *	forget the external symbols of pass 1, to repeat it
+ */
+void
+obj_rewind(void)
+{
+	while (extcnt > 0)
+		free(exttab[--extcnt]);
+}
+
+/*
+ *	write relocatable object:
+ *	RELMAGIC version
+ *	S section name size [Aalign] [B]	B if uninitialised
+ *	D section offset bytes ...
+ *	X no. name			external symbol
+ *	P name section value		public symbol
+ *	R section offset S|X no.	word relative to section or external
+ *	E
+ */
+static void
+rel_write(void)
+{
+	int		 a, end, n;
+	size_t		 i;
+	struct sect	*sp;
+
+	fprintf(objfp, "%s %d\n", RELMAGIC, RELVERS);
+	for (i = 0; (sp = sect_get(i)) != NULL; i++) {
+		fprintf(objfp, "S %zu %s %04X", i + 1, sp->sc_name,
+		    sp->sc_size);
+		if (sp->sc_align > 1)
+			fprintf(objfp, " A%X", sp->sc_align);
+		fprintf(objfp, "%s\n", sp->sc_bss ? " B" : "");
+	}
+	for (i = 0; (sp = sect_get(i)) != NULL; i++) {
+		end = sp->sc_base + sp->sc_size;
+		for (a = sp->sc_base; a < end && a < OBJSIZE;) {
+			if (!obj_set[a]) {
+				a++;
+				continue;
+			}
+			fprintf(objfp, "D %zu %04X", i + 1, a - sp->sc_base);
+			for (n = 0; n < RELDATA && a < end && a < OBJSIZE &&
+			    obj_set[a]; n++, a++)
+				fprintf(objfp, " %02X", obj_buf[a]);
+			putc('\n', objfp);
+		}
+	}
+	for (i = 0; i < extcnt; i++)
+		fprintf(objfp, "X %zu %s\n", i + 1, exttab[i]);
+	for (i = 0; i < pubcnt; i++)
+		fprintf(objfp, "P %s %d %04X\n", pubtab[i]->sym_name,
+		    pubtab[i]->sym_sect, pubtab[i]->sym_val & 0xffff);
+	for (i = 0; i < relcnt; i++)
+		fprintf(objfp, "R %d %04X %c %d\n", reltab[i].rel_in,
+		    reltab[i].rel_off, reltab[i].rel_ext ? 'X' : 'S',
+		    reltab[i].rel_ext ? reltab[i].rel_ext : reltab[i].rel_sect);
+	fprintf(objfp, "E\n");
+}
+
 /*
  *	create a hex record in ASCII and write into object file
  */
@@ -361,3 +646,52 @@ chksum(void)
 		sum += hex_buf[i] & 0xff;
 	return (0x100 - (sum & 0xff));
 }
+
+/*
+ *	write make dependencies of the output files into file fn:
+ *	all source and INCLUDE files read, plus an empty rule for every
+ *	file but the first, so make doesn't fail if one is removed
+ */
+void
+dep_write(const char * const fn, const char * const obj,
+    const char * const lst)
+{
+	FILE		*fp;
+	const char	*p;
+	size_t		 i;
+
+	if ((fp = fopen(fn, "w")) == NULL)
+		fatal(F_FOPEN, fn);
+	dep_name(fp, obj);
+	if (lst != NULL) {
+		putc(' ', fp);
+		dep_name(fp, lst);
+	}
+	putc(':', fp);
+	for (i = 0; (p = src_name(i)) != NULL; i++) {
+		fprintf(fp, " \\\n  ");
+		dep_name(fp, p);
+	}
+	putc('\n', fp);
+	for (i = 1; (p = src_name(i)) != NULL; i++) {
+		putc('\n', fp);
+		dep_name(fp, p);
+		fprintf(fp, ":\n");
+	}
+	fclose(fp);
+}
+
+/*
+ *	write filename into dependency file, quoted for make
+ */
+static void
+dep_name(FILE * const fp, const char *s)
+{
+	for (; *s; s++) {
+		if (*s == ' ' || *s == '\t' || *s == '#')
+			putc('\\', fp);
+		else if (*s == '$')
+			putc('$', fp);
+		putc(*s, fp);
+	}
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for precompiled symbol images
+ *	an INCLUDE file with only EQU's is assembled once into an image
+ *	holding the names, values and line numbers of its symbols and the
+ *	contents hash of the source; INCLUDE maps the image and enters the
+ *	symbols directly, as long as the hash matches the source file
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zz80asm.h"
+
+#define PCHMAGIC	"ZZ80SYM"	/* magic of symbol images */
+#define PCHVERS		1		/* version of symbol images */
+
+/*
+ *	structure header of symbol image
+ */
+struct pch_hdr {
+	char	 ph_magic[8];	/* PCHMAGIC */
+	uint32_t ph_vers;	/* PCHVERS */
+	uint32_t ph_size;	/* size of one symbol entry */
+	uint32_t ph_count;	/* no. of symbols */
+	uint32_t ph_pad;	/* unused */
+	uint64_t ph_hash;	/* contents hash of source file */
+};
+
+/*
+ *	structure symbol entry of symbol image
+ */
+struct pch_sym {
+	int32_t	 ps_val;		/* symbol value */
+	uint32_t ps_line;		/* line no. of definition */
+	char	 ps_name[SYMSIZE + 1];	/* symbol name */
+};
+
+static void	pch_name(char * const, const size_t, const char * const);
+
+/*
+ *	precompile an EQU only source file into its symbol image
+ *
+ *	Input: name of source file
+ *
+ *	Output: no. of errors
+ */
+int
+pch_write(char * const fn)
+{
+	FILE		*fp;
+	size_t		 i, len;
+	char		 path[PATH_MAX], tmpfn[PATH_MAX];
+	struct pch_hdr	 hdr;
+	struct pch_sym	 ps;
+
+	if (src_equonly(fn) != 1) {
+		warnx("%s: not a file with only absolute EQU's", fn);
+		return (1);
+	}
+	pass = 1;
+	pc = 0;
+	errors = 0;
+	p1_file(fn);
+	if (errors)
+		return (errors);
+	len = copy_sym();
+	pch_name(path, sizeof(path), fn);
+	if (snprintf(tmpfn, sizeof(tmpfn), "%s.%ld", path,
+	    (long)getpid()) >= (int)sizeof(tmpfn))
+		fatal(F_FOPEN, path);
+	if ((fp = fopen(tmpfn, "w")) == NULL)
+		fatal(F_FOPEN, tmpfn);
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.ph_magic, PCHMAGIC, sizeof(hdr.ph_magic));
+	hdr.ph_vers = PCHVERS;
+	hdr.ph_size = sizeof(struct pch_sym);
+	hdr.ph_count = (uint32_t)len;
+	hdr.ph_hash = src_hash(fn);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	for (i = 0; i < len; i++) {
+		memset(&ps, 0, sizeof(ps));
+		ps.ps_val = symarray[i]->sym_val;
+		ps.ps_line = (uint32_t)symarray[i]->sym_line;
+		strlcpy(ps.ps_name, symarray[i]->sym_name,
+		    sizeof(ps.ps_name));
+		fwrite(&ps, sizeof(ps), 1, fp);
+	}
+	free(symarray);
+	symarray = NULL;
+	if (ferror(fp) || fclose(fp) == EOF || rename(tmpfn, path) == -1) {
+		unlink(tmpfn);
+		fatal(F_FOPEN, path);
+	}
+	if (ver_flag)
+		fprintf(stdout, "   Write   %s (%zu symbols)\n", path, len);
+	clr_sym();
+	return (0);
+}
+
+/*
+ *	load the symbol image of an INCLUDE file, in pass 1 the symbols
+ *	are entered into the symbol table, in pass 2 the image is only
+ *	checked
+ *
+ *	Input: name of source file
+ *
+ *	Output: 1 symbols loaded from the image
+ *		0 no valid image, source file must be read
+ */
+int
+pch_load(char * const fn)
+{
+	int			 fd;
+	size_t			 i, len;
+	char			 path[PATH_MAX], *save_fn;
+	size_t			 save_line;
+	void			*map;
+	struct stat		 st;
+	const struct pch_hdr	*hdr;
+	const struct pch_sym	*ps;
+
+	pch_name(path, sizeof(path), fn);
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return (0);
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return (0);
+	}
+	len = (size_t)st.st_size;
+	map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return (0);
+	hdr = map;
+	ps = (const struct pch_sym *)(hdr + 1);
+	if (memcmp(hdr->ph_magic, PCHMAGIC, sizeof(hdr->ph_magic)) != 0 ||
+	    hdr->ph_vers != PCHVERS ||
+	    hdr->ph_size != sizeof(struct pch_sym) ||
+	    hdr->ph_count > (len - sizeof(*hdr)) / sizeof(struct pch_sym) ||
+	    hdr->ph_hash != src_hash(fn)) {
+		munmap(map, len);
+		return (0);
+	}
+	if (ver_flag)
+		fprintf(stdout, "   Symbols %s\n", path);
+	if (pass == 1) {
+		save_fn = srcfn;	/* errors refer to the source file */
+		save_line = c_line;
+		srcfn = fn;
+		for (i = 0; i < hdr->ph_count; i++, ps++) {
+			c_line = ps->ps_line;
+			if (ps->ps_name[SYMSIZE] != '\0')
+				fatal(F_INTERN, "corrupt symbol image");
+			if (get_sym(ps->ps_name) != NULL)
+				asmerr(E_MULSYM);
+			else if (put_sym(ps->ps_name, ps->ps_val))
+				fatal(F_OUTMEM, "symbols");
+		}
+		srcfn = save_fn;
+		c_line = save_line;
+	}
+	munmap(map, len);
+	src_mark(fn);
+	return (1);
+}
+
+/*
+ *	name of the symbol image of a source file: the extension
+ *	of the source file is replaced by PCHEXT
+ */
+static void
+pch_name(char * const dest, const size_t size, const char * const fn)
+{
+	char	*p;
+
+	strlcpy(dest, fn, size);
+	if ((p = strrchr(dest, '.')) != NULL && strchr(p, '/') == NULL)
+		*p = '\0';
+	strlcat(dest, PCHEXT, size);
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the timers and counters of -T
+ *	every phase of the assembly accumulates the wall clock and the
+ *	CPU time spent in it, the counters in perf are incremented by
+ *	the functions they count, the chains of the symbol table are
+ *	measured when printing
+ *	the report is printed to stdout as text, or as JSON
+ *	with -g the phases, source files and INCLUDE's are also written
+ *	as nested spans to a trace in the Chrome trace event format
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "zz80asm.h"
+
+static double	 pf_now(const clockid_t);
+static void	 pf_str(FILE * const, const char * const);
+static void	 pf_event(const char * const, const char * const, const int);
+static long long pf_size(const char * const);
+
+struct perf	 perf;			/* counters */
+
+static const char *pf_names[PF_NPHASE] = {	/* names of the phases */
+	"pass 1", "pass 2", "output", "tests", "symbol sort", "listing"
+};
+static const char *pf_keys[PF_NPHASE] = {	/* keys in JSON */
+	"pass1", "pass2", "output", "tests", "sort", "listing"
+};
+static double	 pf_wall[PF_NPHASE];	/* wall clock seconds by phase */
+static double	 pf_cpu[PF_NPHASE];	/* CPU seconds by phase */
+static FILE	*pf_fp;			/* trace of -g, or NULL */
+static double	 pf_t0;			/* start of the trace */
+
+/*
+ *	start the timers of a phase
+ */
+void
+perf_start(const int ph)
+{
+	pf_wall[ph] -= pf_now(CLOCK_MONOTONIC);
+	pf_cpu[ph] -= pf_now(CLOCK_PROCESS_CPUTIME_ID);
+	if (pf_fp != NULL)
+		pf_event(pf_names[ph], "phase", 'B');
+}
+
+/*
+ *	stop the timers of a phase, a phase may be timed several times
+ */
+void
+perf_stop(const int ph)
+{
+	pf_wall[ph] += pf_now(CLOCK_MONOTONIC);
+	pf_cpu[ph] += pf_now(CLOCK_PROCESS_CPUTIME_ID);
+	if (pf_fp != NULL)
+		pf_event(pf_names[ph], "phase", 'E');
+}
+
+/*
+ *	open the trace of -g, the process is named after the object
+ *
+ *	Input: names of trace and object
+ */
+void
+perf_trace(const char * const fn, const char * const objfn)
+{
+	if ((pf_fp = fopen(fn, "w")) == NULL)
+		fatal(F_FOPEN, fn);
+	pf_t0 = pf_now(CLOCK_MONOTONIC);
+	fprintf(pf_fp, "[\n{ \"name\": \"process_name\", \"ph\": \"M\", "
+	    "\"pid\": %ld, \"tid\": 1, \"args\": { \"name\": ",
+	    (long)getpid());
+	pf_str(pf_fp, objfn);
+	fprintf(pf_fp, " } }");
+}
+
+/*
+ *	begin a span of a source file or an INCLUDE in the trace
+ */
+void
+perf_begin(const char * const name, const char * const cat)
+{
+	if (pf_fp != NULL)
+		pf_event(name, cat, 'B');
+}
+
+/*
+ *	end the last span begun with perf_begin()
+ */
+void
+perf_end(const char * const name, const char * const cat)
+{
+	if (pf_fp != NULL)
+		pf_event(name, cat, 'E');
+}
+
+/*
+ *	close the trace of -g
+ */
+void
+perf_close(void)
+{
+	if (pf_fp == NULL)
+		return;
+	fprintf(pf_fp, "\n]\n");
+	fclose(pf_fp);
+	pf_fp = NULL;
+}
+
+/*
+ *	print the timers and counters
+ *
+ *	Input: 't' for text, 'j' for JSON
+ *	       names of object and listing, NULL if none
+ */
+void
+perf_print(const int fmt, const char * const objfn, const char * const lstfn)
+{
+	struct sym	*np;
+	struct rusage	 ru;
+	size_t		 i, n, nsym, nused, chain;
+	double		 mean;
+
+	nsym = nused = chain = 0;
+	for (i = 0; i < HASHSIZE; i++) {
+		for (n = 0, np = symtab[i]; np != NULL; np = np->sym_next)
+			n++;
+		nsym += n;
+		nused += n != 0;
+		if (n > chain)
+			chain = n;
+	}
+	mean = nused ? (double)nsym / (double)nused : 0.0;
+	if (getrusage(RUSAGE_SELF, &ru) == -1)
+		ru.ru_maxrss = 0;
+	if (fmt == 'j') {
+		printf("{\n  \"phases\": {\n");
+		for (i = 0; i < PF_NPHASE; i++)
+			printf("    \"%s\": { \"wall\": %.6f, "
+			    "\"cpu\": %.6f }%s\n", pf_keys[i], pf_wall[i],
+			    pf_cpu[i], (i < PF_NPHASE - 1) ? "," : "");
+		printf("  },\n  \"counters\": {\n");
+		printf("    \"lines_pass1\": %lu,\n", perf.pf_lines[0]);
+		printf("    \"lines_pass2\": %lu,\n", perf.pf_lines[1]);
+		printf("    \"search_op\": %lu,\n", perf.pf_search);
+		printf("    \"get_reg\": %lu,\n", perf.pf_getreg);
+		printf("    \"get_sym\": %lu,\n", perf.pf_getsym);
+		printf("    \"sym_probes\": %lu,\n", perf.pf_probes);
+		printf("    \"eval\": %lu,\n", perf.pf_eval);
+		printf("    \"eval_depth\": %d,\n", perf.pf_maxdepth);
+		printf("    \"symbols\": %zu,\n", nsym);
+		printf("    \"chain_max\": %zu,\n", chain);
+		printf("    \"chain_mean\": %.2f,\n", mean);
+		printf("    \"maxrss_kb\": %ld\n", (long)ru.ru_maxrss);
+		printf("  },\n  \"outputs\": {");
+		if (objfn != NULL) {
+			printf("\n    ");
+			pf_str(stdout, objfn);
+			printf(": %lld", pf_size(objfn));
+		}
+		if (lstfn != NULL) {
+			printf("%s\n    ", (objfn != NULL) ? "," : "");
+			pf_str(stdout, lstfn);
+			printf(": %lld", pf_size(lstfn));
+		}
+		printf("\n  }\n}\n");
+		return;
+	}
+	printf("%-16s %12s %12s\n", "Phase", "Wall s", "CPU s");
+	for (i = 0; i < PF_NPHASE; i++)
+		printf("%-16s %12.6f %12.6f\n", pf_names[i], pf_wall[i],
+		    pf_cpu[i]);
+	printf("%-16s %12lu\n", "lines pass 1", perf.pf_lines[0]);
+	printf("%-16s %12lu\n", "lines pass 2", perf.pf_lines[1]);
+	printf("%-16s %12lu\n", "search_op", perf.pf_search);
+	printf("%-16s %12lu\n", "get_reg", perf.pf_getreg);
+	printf("%-16s %12lu\n", "get_sym", perf.pf_getsym);
+	printf("%-16s %12lu\n", "symbol probes", perf.pf_probes);
+	printf("%-16s %12lu\n", "eval", perf.pf_eval);
+	printf("%-16s %12d\n", "eval depth", perf.pf_maxdepth);
+	printf("%-16s %12zu\n", "symbols", nsym);
+	printf("%-16s %12zu\n", "chain max", chain);
+	printf("%-16s %12.2f\n", "chain mean", mean);
+	printf("%-16s %12ld\n", "max RSS KB", (long)ru.ru_maxrss);
+	if (objfn != NULL)
+		printf("%-16s %12lld %s\n", "bytes", pf_size(objfn), objfn);
+	if (lstfn != NULL)
+		printf("%-16s %12lld %s\n", "bytes", pf_size(lstfn), lstfn);
+}
+
+/*
+ *	seconds of a clock
+ */
+static double
+pf_now(const clockid_t id)
+{
+	struct timespec	ts;
+
+	clock_gettime(id, &ts);
+	return ((double)ts.tv_sec + (double)ts.tv_nsec / 1e9);
+}
+
+/*
+ *	write an event of the trace, ph is 'B' for begin, 'E' for end,
+ *	the time stamp is in microseconds
+ */
+static void
+pf_event(const char * const name, const char * const cat, const int ph)
+{
+	fprintf(pf_fp, ",\n{ \"name\": ");
+	pf_str(pf_fp, name);
+	fprintf(pf_fp, ", \"cat\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, "
+	    "\"pid\": %ld, \"tid\": 1 }", cat, ph,
+	    (pf_now(CLOCK_MONOTONIC) - pf_t0) * 1e6, (long)getpid());
+}
+
+/*
+ *	write a string quoted for JSON
+ */
+static void
+pf_str(FILE * const fp, const char * const s)
+{
+	const char	*p;
+
+	putc('"', fp);
+	for (p = s; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			putc('\\', fp);
+		putc(*p, fp);
+	}
+	putc('"', fp);
+}
+
+/*
+ *	size of an output file, -1 if it doesn't exist
+ */
+static long long
+pf_size(const char * const fn)
+{
+	struct stat	st;
+
+	if (stat(fn, &st) == -1)
+		return (-1);
+	return ((long long)st.st_size);
+}
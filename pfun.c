@@ -26,7 +26,9 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "zz80asm.h"
 
@@ -38,6 +40,19 @@ char		tmp[LINE_MAX];		/* temporary buffer */
 
 static int	prg_flag = 0;		/* flag for prg_adr valid */
 
+static struct inc *incl;		/* stack of nested INCLUDE's */
+static size_t	incsize;		/* size of INCLUDE stack */
+static size_t	incnest;		/* INCLUDE nesting level */
+static int	cross_adr = -1;		/* start of NOCROSS region, or -1 */
+static size_t	cross_sect;		/* section of NOCROSS region */
+static char	*cross_fn;		/* file of NOCROSS */
+static size_t	cross_line;		/* line no. of NOCROSS */
+static int	*condnest;		/* stack of nested IF's */
+static size_t	condsize;		/* size of IF stack */
+
+static void	inc_grow(void);
+static void	cond_grow(void);
+
 /*
  *	ORG
  */
@@ -48,18 +63,21 @@ op_org(void)
 
 	if (!gencode)
 		return (0);
-	i = eval(operand);
+	if ((i = sect_org(eval(operand))) < 0) {
+		asmerr(E_ILLORG);
+		return (0);
+	}
 	if (i < pc) {
 		asmerr(E_MEMOVR);
 		return (0);
 	}
 	if (pass == 1) {		/* PASS 1 */
-		if (!prg_flag) {
+		if (!prg_flag && sect_cur() == 0) {
 			prg_adr = i;
 			prg_flag++;
 		}
 	} else {			/* PASS 2 */
-		if (++prg_flag > 2)
+		if (sect_cur() == 0 && ++prg_flag > 2)
 			obj_fill(i - pc);
 		sd_flag = 2;
 	}
@@ -78,8 +96,11 @@ op_equ(void)
 	if (pass == 1) {		/* Pass 1 */
 		if (get_sym(label) == NULL) {
 			sd_val = eval(operand);
+			if (ev_late)
+				asmerr(E_ILLREL);
 			if (put_sym(label, sd_val))
 				fatal(F_OUTMEM, "symbols");
+			set_rel(label);
 		} else
 			asmerr(E_MULSYM);
 	} else {			/* Pass 2 */
@@ -101,6 +122,7 @@ op_dl(void)
 	sd_val = eval(operand);
 	if (put_sym(label, sd_val))
 		fatal(F_OUTMEM, "symbols");
+	set_rel(label);
 	return (0);
 }
 
@@ -118,7 +140,7 @@ op_ds(void)
 		put_label();
 	sd_val = pc;
 	sd_flag = 3;
-	val = eval(operand);
+	val = eval_fixed(operand);
 	if ((pass == 2) && dump_flag)
 		obj_fill(val);
 	pc += val;
@@ -227,6 +249,7 @@ op_dw(void)
 			temp = eval(tmp);
 			ops[i++] = temp & 0xff;
 			ops[i++] = temp >> 8;
+			obj_reloc(i - 2);
 			if (i >= OPCARRAY)
 				fatal(F_INTERN, "Op-Code buffer overflow");
 		}
@@ -238,15 +261,15 @@ op_dw(void)
 }
 
 /*
- *	EJECT, LIST, NOLIST, PAGE, PRINT, TITLE, INCLUDE
+ *	EJECT, LIST, NOLIST, PAGE, PRINT, TITLE, INCLUDE, INCLUDE ONCE
  */
 int
 op_misc(const int op_code)
 {
-	char		*p, *d;
+	char		*p, *q, *d;
+	int		 once;
+	size_t		 i;
 	static char	 fn[PATH_MAX];
-	static int	 incnest;
-	static struct	 inc incl[INCNEST];
 
 	if (!gencode)
 		return (0);
@@ -281,36 +304,71 @@ op_misc(const int op_code)
 		}
 		break;
 	case 6:				/* INCLUDE */
-		if (incnest >= INCNEST) {
-			asmerr(E_INCNEST);
+		p = line;
+		while (isspace((int)*p))	/* no white space to INCLUDE */
+			p++;
+		while (!isspace((int)*p))	/* ignore INCLUDE */
+			p++;
+		once = 0;
+		for (;;) {
+			while (isspace((int)*p))	/* skip to filename */
+				p++;
+			d = fn;
+			while (!isspace((int)*p) && *p != COMMENT &&
+			    *p != '\0')		/* get filename */
+				*d++ = *p++;
+			*d = '\0';
+			if (once || strcasecmp(fn, "ONCE") != 0)
+				break;
+			q = p;			/* INCLUDE ONCE filename */
+			while (isspace((int)*q))
+				q++;
+			if (*q == '\0' || *q == COMMENT)
+				break;		/* file is named ONCE */
+			once = 1;
+		}
+		if (src_skip(fn, once)) {
+			if (ver_flag)
+				fprintf(stdout, "   Skip    %s\n", fn);
+			break;
+		}
+		if (src_same(fn, srcfn)) {
+			asmerr(E_INCREC);
+			break;
+		}
+		for (i = 0; i < incnest; i++)
+			if (src_same(fn, incl[i].inc_fn))
+				break;
+		if (i < incnest) {
+			asmerr(E_INCREC);
 			break;
 		}
+		/* the listing needs the text of the file in pass 2 */
+		if ((pass == 1 || !list_flag) && pch_load(fn))
+			break;
+		if (incnest == incsize)
+			inc_grow();
 		incl[incnest].inc_line = c_line;
 		incl[incnest].inc_fn = srcfn;
 		incl[incnest].inc_fp = srcfp;
 		incnest++;
-		p = line;
-		d = fn;
-		while (isspace((int)*p))	/* no white space to INCLUDE */
-			p++;
-		while (!isspace((int)*p))	/* ignore INCLUDE */
-			p++;
-		while (isspace((int)*p))	/* no white space to filename */
-			p++;
-		while (!isspace((int)*p) && *p != COMMENT) /* get filename */
-			*d++ = *p++;
-		*d = '\0';
+		/* fn is reused by nested files */
+		if ((p = strdup(fn)) == NULL)
+			fatal(F_OUTMEM, "filenames");
+		perf_begin(p, "include");
 		if (pass == 1) {	/* PASS 1 */
 			if (ver_flag)
-				fprintf(stdout, "   Include %s\n", fn);
-			p1_file(fn);
+				fprintf(stdout, "   Include %s\n", p);
+			p1_file(p);
 		} else {		/* PASS 2 */
 			sd_flag = 2;
 			lst_line(0, 0);
 			if (ver_flag)
-				fprintf(stdout, "   Include %s\n", fn);
-			p2_file(fn);
+				fprintf(stdout, "   Include %s\n", p);
+			p2_file(p);
 		}
+		perf_end(p, "include");
+		free(p);
 		incnest--;
 		c_line = incl[incnest].inc_line;
 		srcfn = incl[incnest].inc_fn;
@@ -354,34 +412,27 @@ int
 op_cond(const int op_code)
 {
 	char		*p, *p1, *p2;
-	static int	 condnest[IFNEST];
 
 	switch (op_code) {
 	case 1:				/* IFDEF */
-		if (iflevel >= IFNEST) {
-			asmerr(E_IFNEST);
-			break;
-		}
+		if ((size_t)iflevel == condsize)
+			cond_grow();
 		condnest[iflevel++] = gencode;
 		if (gencode)
 			if (get_sym(operand) == NULL)
 				gencode = 0;
 		break;
 	case 2:				/* IFNDEF */
-		if (iflevel >= IFNEST) {
-			asmerr(E_IFNEST);
-			break;
-		}
+		if ((size_t)iflevel == condsize)
+			cond_grow();
 		condnest[iflevel++] = gencode;
 		if (gencode)
 			if (get_sym(operand) != NULL)
 				gencode = 0;
 		break;
 	case 3:				/* IFEQ */
-		if (iflevel >= IFNEST) {
-			asmerr(E_IFNEST);
-			break;
-		}
+		if ((size_t)iflevel == condsize)
+			cond_grow();
 		condnest[iflevel++] = gencode;
 		p = operand;
 		p1 = strchr(operand, ',');
@@ -394,15 +445,13 @@ op_cond(const int op_code)
 			while (*p != ',')
 				*p2++ = *p++;
 			*p2 = '\0';
-			if (eval(tmp) != eval(++p1))
+			if (eval_fixed(tmp) != eval_fixed(++p1))
 				gencode = 0;
 		}
 		break;
 	case 4:				/* IFNEQ */
-		if (iflevel >= IFNEST) {
-			asmerr(E_IFNEST);
-			break;
-		}
+		if ((size_t)iflevel == condsize)
+			cond_grow();
 		condnest[iflevel++] = gencode;
 		p = operand;
 		p1 = strchr(operand, ',');
@@ -415,7 +464,7 @@ op_cond(const int op_code)
 			while (*p != ',')
 				*p2++ = *p++;
 			*p2 = '\0';
-			if (eval(tmp) == eval(++p1))
+			if (eval_fixed(tmp) == eval_fixed(++p1))
 				gencode = 0;
 		}
 		break;
@@ -441,21 +490,334 @@ op_cond(const int op_code)
 
 /*
  *	EXTRN and PUBLIC
+ *	only used for relocatable objects, otherwise ignored
  */
 int
 op_glob(const int op_code)
 {
+	char		*p, *s;
+	struct sym	*sp;
+
 	if (!gencode)
 		return (0);
 	sd_flag = 2;
+	if (out_form != OUTREL)
+		return (0);
+	p = operand;
+	while (*p) {
+		s = tmp;
+		while (*p != ',' && *p != '\0')
+			*s++ = *p++;
+		*s = '\0';
+		if (*p == ',')
+			p++;
+		if (strlen(tmp) > SYMSIZE)
+			tmp[SYMSIZE] = '\0';
+		if (*tmp == '\0') {
+			asmerr(E_MISOPE);
+			continue;
+		}
+		sp = get_sym(tmp);
+		switch (op_code) {
+		case 1:				/* EXTRN */
+			if (pass == 2)
+				break;
+			if (sp != NULL) {
+				if (!sp->sym_ext)
+					asmerr(E_MULSYM);
+				break;
+			}
+			if (put_sym(tmp, 0))
+				fatal(F_OUTMEM, "symbols");
+			get_sym(tmp)->sym_ext = obj_extern(tmp);
+			break;
+		case 2:				/* PUBLIC */
+			if (pass == 1)
+				break;
+			if (sp == NULL)
+				asmerr(E_UNDSYM);
+			else if (sp->sym_ext)
+				asmerr(E_ILLREL);
+			else
+				obj_public(sp);
+			break;
+		default:
+			fatal(F_INTERN, "illegal opcode for function op_glob");
+			/* NOTREACHED */
+		}
+	}
+	return (0);
+}
+
+/*
+ *	SECTION
+ */
+int
+op_sect(void)
+{
+	char	*p;
+	int	 bss;
+
+	if (!gencode)
+		return (0);
+	bss = 0;
+	if ((p = strchr(operand, ',')) != NULL) {
+		*p++ = '\0';
+		if (strcmp(p, "BSS") == 0)
+			bss = 1;
+		else
+			asmerr(E_ILLOPE);
+	}
+	if (*operand == '\0') {
+		asmerr(E_MISOPE);
+		return (0);
+	}
+	if (strlen(operand) > SYMSIZE)
+		operand[SYMSIZE] = '\0';
+	sect_switch(operand, bss);
+	if ((pass == 1) && *label)
+		put_label();
+	return (0);
+}
+
+/*
+ *	ALIGN
+ */
+int
+op_align(void)
+{
+	int	n, pad;
+
+	if (!gencode)
+		return (0);
+	n = eval_fixed(operand);
+	if (n < 1 || n > 32768 || (n & (n - 1))) {
+		asmerr(E_VALOUT);
+		return (0);
+	}
+	pad = sect_align(n);
+	if (pass == 2)
+		obj_fill(pad);
+	pc += pad;
+	if ((pass == 1) && *label)
+		put_label();
+	sd_val = pc;
+	sd_flag = 3;
+	return (0);
+}
+
+/*
+ *	ALIGNED
+ */
+int
+op_aligned(void)
+{
+	int	n;
+
+	if (!gencode)
+		return (0);
+	if ((pass == 1) && *label)
+		put_label();
+	n = eval_fixed(operand);
+	if (n < 1 || n > 32768 || (n & (n - 1))) {
+		asmerr(E_VALOUT);
+		return (0);
+	}
+	if (sect_align(n) && pass == 2)
+		asmerr_adr(E_NOTALN, pc, ALIGNUP(pc, n));
+	return (0);
+}
+
+/*
+ *	NOCROSS and ENDCROSS, checked in pass 2 if the addresses are known
+ */
+int
+op_cross(const int op_code)
+{
+	if (!gencode)
+		return (0);
+	if ((pass == 1) && *label)
+		put_label();
+	if (pass == 1)
+		return (0);
 	switch (op_code) {
-	case 1:				/* EXTRN */
+	case 1:				/* NOCROSS */
+		if (cross_adr >= 0)
+			asmerr(E_MISNCR);
+		cross_adr = pc;
+		cross_sect = sect_cur();
+		free(cross_fn);
+		if ((cross_fn = strdup(srcfn)) == NULL)
+			fatal(F_OUTMEM, "NOCROSS");
+		cross_line = c_line;
 		break;
-	case 2:				/* PUBLIC */
+	case 2:				/* ENDCROSS */
+		if (cross_adr < 0 || cross_sect != sect_cur())
+			asmerr(E_MISNCR);
+		else if (out_form != OUTREL && pc > cross_adr &&
+		    (cross_adr >> 8) != ((pc - 1) >> 8))
+			asmerr_adr(E_PGCROS, cross_adr, pc - 1);
+		cross_adr = -1;
 		break;
 	default:
-		fatal(F_INTERN, "illegal opcode for function op_glob");
+		fatal(F_INTERN, "illegal opcode for function op_cross");
 		/* NOTREACHED */
 	}
 	return (0);
 }
+
+/*
+ *	report a NOCROSS without ENDCROSS at the end of pass 2
+ */
+void
+cross_check(void)
+{
+	if (cross_adr >= 0)
+		asmerr_at(E_MISNCR, cross_fn, cross_line, "end of source");
+	cross_adr = -1;
+}
+
+/*
+ *	CYCLES
+ */
+int
+op_cycles(void)
+{
+	char	*p, *s;
+	int	 v[4], n;
+
+	if (!gencode)
+		return (0);
+	if ((pass == 1) && *label)
+		put_label();
+	if (pass == 1)
+		return (0);
+	sd_flag = 2;
+	p = operand;
+	for (n = 0; n < 4 && *p; n++) {
+		s = tmp;
+		while (*p != ',' && *p != '\0')
+			*s++ = *p++;
+		*s = '\0';
+		if (*p == ',')
+			p++;
+		v[n] = eval(tmp);
+		if (ev_ext)
+			asmerr(E_ILLREL);
+		else if (ev_sect)	/* position in relocatable object */
+			v[n] += sect_get((size_t)ev_sect - 1)->sc_base;
+	}
+	if (n < 3) {
+		asmerr(E_MISOPE);
+		return (0);
+	}
+	if (*p || v[1] < v[0]) {
+		asmerr(E_ILLOPE);
+		return (0);
+	}
+	cyc_budget(v[0], v[1], v[2], (n == 4) ? v[3] : -1);
+	return (0);
+}
+
+/*
+ *	OPT and NOOPT
+ */
+int
+op_opt(const int op_code)
+{
+	if (!gencode)
+		return (0);
+	if ((pass == 1) && *label)
+		put_label();
+	if (pass == 2)
+		sd_flag = 2;
+	opt_set(op_code == 1);
+	return (0);
+}
+
+/*
+ *	UTEST, USET and UEXPECT, collected in pass 2 for -u
+ */
+int
+op_test(const int op_code)
+{
+	char	*p, *s;
+	int	 reg, adr;
+
+	if (!gencode)
+		return (0);
+	if ((pass == 1) && *label)
+		put_label();
+	if (pass == 1)
+		return (0);
+	sd_flag = 2;
+	p = operand;
+	s = tmp;
+	while (*p != ',' && *p != '\0')
+		*s++ = *p++;
+	*s = '\0';
+	if (*p == ',')
+		p++;
+	if (*tmp == '\0') {
+		asmerr(E_MISOPE);
+		return (0);
+	}
+	if (op_code == 1) {			/* UTEST */
+		adr = eval(tmp);
+		test_begin(adr, *p ? (unsigned long)eval(p) : 0);
+		return (0);
+	}
+	reg = -1;				/* USET, UEXPECT */
+	adr = 0;
+	if (*tmp == '(' && tmp[strlen(tmp) - 1] == ')') {
+		tmp[strlen(tmp) - 1] = '\0';
+		adr = eval(tmp + 1);
+	} else if ((reg = test_reg(tmp)) < 0 ||
+	    (op_code == 2 && strcmp(tmp, "T") == 0)) {
+		asmerr(E_ILLOPE);
+		return (0);
+	}
+	if (*p == '\0') {
+		asmerr(E_MISOPE);
+		return (0);
+	}
+	if (!test_value(op_code == 3, reg, adr, eval(p)))
+		asmerr(E_MISTST);
+	return (0);
+}
+
+/*
+ *	grow stack of nested INCLUDE's
+ */
+static void
+inc_grow(void)
+{
+	size_t		 newsize;
+	struct inc	*newstack;
+
+	newsize = incsize + NESTINC;
+	if (newsize > SIZE_MAX / sizeof(struct inc))
+		fatal(F_INTERN, "overflow");
+	if ((newstack = realloc(incl, newsize * sizeof(struct inc))) == NULL)
+		fatal(F_OUTMEM, "INCLUDE nesting");
+	incl = newstack;
+	incsize = newsize;
+}
+
+/*
+ *	grow stack of nested IF's
+ */
+static void
+cond_grow(void)
+{
+	size_t	 newsize;
+	int	*newstack;
+
+	newsize = condsize + NESTINC;
+	if (newsize > SIZE_MAX / sizeof(int))
+		fatal(F_INTERN, "overflow");
+	if ((newstack = realloc(condnest, newsize * sizeof(int))) == NULL)
+		fatal(F_OUTMEM, "IF nesting");
+	condnest = newstack;
+	condsize = newsize;
+}
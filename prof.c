@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the execution profile of -P
+ *	a profile has a line "address count [cycles]" for every address
+ *	executed, address in hex; without cycles, they are estimated
+ *	from the T-states of the instruction as the condition is met
+ *	in pass 2 the counts and cycles are added to the listing, and
+ *	summed up for every label to show the hotspots
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zz80asm.h"
+
+#define PROFSIZE	65536	/* size of Z80 address space */
+
+/*
+ *	structure hotspots
+ */
+struct hot {
+	char		 ho_name[SYMSIZE + 1];	/* label */
+	unsigned long	 ho_count;	/* executions of first instruction */
+	unsigned long	 ho_cycles;	/* cycles of all instructions */
+};
+
+static int	 hot_cmp(const void *, const void *);
+
+static const char	*prof_fn;	/* profile filename */
+static unsigned long	*prof_cnt;	/* executions of every address */
+static unsigned long	*prof_cyc;	/* cycles of every address */
+static unsigned char	*prof_set;	/* cycles of the address given */
+static char		 prof_col[32];	/* column for lst_line() */
+static struct hot	*hots;		/* labels in source order */
+static size_t		 nhots, shots;	/* no. and size of hots */
+static int		 curhot = -1;	/* label of the current line */
+static int		 hotfirst;	/* next code is first of the label */
+
+/*
+ *	read the profile
+ */
+void
+prof_load(const char * const fn)
+{
+	FILE		*fp;
+	char		 buf[LINE_MAX], *p;
+	unsigned int	 a;
+	unsigned long	 cnt, cyc;
+	size_t		 ln;
+	int		 n;
+
+	if ((fp = fopen(fn, "r")) == NULL)
+		fatal(F_FOPEN, fn);
+	if ((prof_cnt = calloc(PROFSIZE, sizeof(unsigned long))) == NULL ||
+	    (prof_cyc = calloc(PROFSIZE, sizeof(unsigned long))) == NULL ||
+	    (prof_set = calloc(PROFSIZE, 1)) == NULL)
+		fatal(F_OUTMEM, "profile");
+	for (ln = 1; fgets(buf, sizeof(buf), fp) != NULL; ln++) {
+		for (p = buf; *p == ' ' || *p == '\t'; p++)
+			;
+		if (*p == '\n' || *p == '#' || *p == '\0')
+			continue;
+		n = sscanf(p, "%x %lu %lu", &a, &cnt, &cyc);
+		if (n < 2 || a >= PROFSIZE)
+			errx(1, "%s: line %zu: bad profile entry", fn, ln);
+		prof_cnt[a] += cnt;
+		if (n == 3) {
+			prof_cyc[a] += cyc;
+			prof_set[a] = 1;
+		}
+	}
+	fclose(fp);
+	prof_fn = fn;
+}
+
+/*
+ *	count the instruction at pc for the listing and the label
+ *
+ *	Input: opcode table entry, NULL for a line without opcode,
+ *	       length of the instruction in ops[], 0 if no code
+ */
+void
+prof_line(const struct opc * const op, const size_t n)
+{
+	unsigned long	 cnt, cyc;
+	int		 t, alt, a;
+
+	*prof_col = '\0';
+	if (*label && (op == NULL || (op->op_fun != op_equ &&
+	    op->op_fun != op_dl))) {
+		if (nhots == shots)
+			hots = grow_tab(hots, &shots, sizeof(struct hot));
+		strlcpy(hots[nhots].ho_name, label, sizeof(hots[0].ho_name));
+		hots[nhots].ho_count = hots[nhots].ho_cycles = 0;
+		curhot = (int)nhots++;
+		hotfirst = 1;
+	}
+	if (n == 0 || (t = cyc_count(ops, n, &alt)) < 0)
+		return;
+	a = sect_addr(pc);
+	cnt = prof_cnt[a];
+	cyc = prof_set[a] ? prof_cyc[a] : cnt * (unsigned long)t;
+	snprintf(prof_col, sizeof(prof_col), "%10lu %12lu ", cnt, cyc);
+	if (curhot < 0)
+		return;
+	if (hotfirst)
+		hots[curhot].ho_count = cnt;
+	hotfirst = 0;
+	hots[curhot].ho_cycles += cyc;
+}
+
+/*
+ *	column of counts for the listing line, cleared after use
+ */
+const char *
+prof_list(void)
+{
+	static char	buf[sizeof(prof_col)];
+
+	snprintf(buf, sizeof(buf), "%-24s", prof_col);
+	*prof_col = '\0';
+	return (buf);
+}
+
+/*
+ *	print the labels with cycles, most cycles first, at the end
+ *	of the listing or to stderr, stdout may hold the JSON of -T j
+ */
+void
+prof_end(void)
+{
+	FILE		*fp;
+	size_t		 i;
+	unsigned long	 total;
+
+	fp = (lstfp != NULL) ? lstfp : stderr;
+	for (total = 0, i = 0; i < nhots; i++)
+		total += hots[i].ho_cycles;
+	qsort(hots, nhots, sizeof(struct hot), hot_cmp);
+	fprintf(fp, "\nHotspots of profile %s:\n", prof_fn);
+	fprintf(fp, "LABEL         COUNT       CYCLES      %%\n");
+	for (i = 0; i < nhots && hots[i].ho_cycles; i++)
+		fprintf(fp, "%-8s %10lu %12lu %6.2f\n", hots[i].ho_name,
+		    hots[i].ho_count, hots[i].ho_cycles,
+		    100.0 * (double)hots[i].ho_cycles / (double)total);
+}
+
+/*
+ *	compare hotspots by cycles, for qsort()
+ */
+static int
+hot_cmp(const void *a, const void *b)
+{
+	const struct hot	*ha = a, *hb = b;
+
+	if (ha->ho_cycles != hb->ho_cycles)
+		return ((ha->ho_cycles < hb->ho_cycles) ? 1 : -1);
+	return (strcmp(ha->ho_name, hb->ho_name));
+}
@@ -32,11 +32,15 @@
 static int	 calc_val(const char * const);
 static char	*get_second(const char * const);
 static int	 lda (void), ldb(void), ldc(void), ldd(void), lde(void);
-static int	 ldh (void), ldl(void);
+static int	 ldh (void), ldl(void), ldhalf(const int);
 static int	 ldbc(void), ldde(void), ldhl(void), ldix(void), ldiy(void);
 static int	 ldsp(void), ldihl(void), ldiix(void), ldiiy(void), ldinn(void);
 static int	 adda(void), addhl(void), addix(void), addiy(void);
+static int	 addrr(const int);
 static int	 adca(void), adchl(void), sbca(void), sbchl(void);
+static int	 op_relax(const int, const int);
+static int	 half_pfx(const int), half_reg(const int);
+static int	 idx_copy(const char * const);
 
 int	ops[OPCARRAY];	/* buffer for generated object code */
 
@@ -105,7 +109,7 @@ op_im(void)
 int
 op_pupo(const int op_code)
 {
-	int	len;
+	int	i, len;
 
 	if ((pass == 1) && *label)
 		put_label();
@@ -170,6 +174,22 @@ op_pupo(const int op_code)
 		}
 		len = 2;
 		break;
+	case NOREG:
+		if (cpu_type == CPUZ80N && op_code == 2) {
+			if (pass == 2) {
+				i = eval(operand);
+				ops[0] = 0xed;		/* PUSH nn, Z80N */
+				ops[1] = 0x8a;
+				ops[2] = (i >> 8) & 0xff;	/* high first */
+				ops[3] = i & 0xff;
+			}
+			len = 4;
+			break;
+		}
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_ILLOPE);
+		break;
 	case NOOPERA:					/* missing operand */
 		len = 1;
 		ops[0] = 0;
@@ -242,54 +262,63 @@ op_call(void)
 			ops[0] = 0xdc;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case FLGNC:				/* CALL NC,nn */
 			i = eval(strchr(operand, ',') + 1);
 			ops[0] = 0xd4;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case FLGZ:				/* CALL Z,nn */
 			i = eval(strchr(operand, ',') + 1);
 			ops[0] = 0xcc;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case FLGNZ:				/* CALL NZ,nn */
 			i = eval(strchr(operand, ',') + 1);
 			ops[0] = 0xc4;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case FLGPE:				/* CALL PE,nn */
 			i = eval(strchr(operand, ',') + 1);
 			ops[0] = 0xec;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case FLGPO:				/* CALL PO,nn */
 			i = eval(strchr(operand, ',') + 1);
 			ops[0] = 0xe4;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case FLGM:				/* CALL M,nn */
 			i = eval(strchr(operand, ',') + 1);
 			ops[0] = 0xfc;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case FLGP:				/* CALL P,nn */
 			i = eval(strchr(operand, ',') + 1);
 			ops[0] = 0xf4;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case NOREG:				/* CALL nn */
 			i = eval(operand);
 			ops[0] = 0xcd;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 			break;
 		case NOOPERA:				/* missing operand */
 			ops[0] = 0;
@@ -382,7 +411,7 @@ int
 op_jp(void)
 {
 	char	*p1, *p2;
-	int	 i, len;
+	int	 i, len, reg;
 
 	if ((pass == 1) && *label)
 		put_label();
@@ -391,7 +420,13 @@ op_jp(void)
 	while (*p1 != ',' && *p1 != '\0')
 		*p2++ = *p1++;
 	*p2 = '\0';
-	switch (get_reg(tmp)) {
+	reg = get_reg(tmp);
+	if (cpu_type == CPUZ80N && strcmp(operand, "(C)") == 0)
+		return (op_2b(0xed, 0x98));		/* JP (C), Z80N */
+	if (relax_flag && (reg == NOREG || reg == REGC || reg == FLGNC ||
+	    reg == FLGZ || reg == FLGNZ))
+		return (op_relax(reg, 3));
+	switch (reg) {
 	case REGC:					/* JP C,nn */
 		len = 3;
 		if (pass == 2) {
@@ -399,6 +434,7 @@ op_jp(void)
 			ops[0] = 0xda;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case FLGNC:					/* JP NC,nn */
@@ -408,6 +444,7 @@ op_jp(void)
 			ops[0] = 0xd2;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case FLGZ:					/* JP Z,nn */
@@ -417,6 +454,7 @@ op_jp(void)
 			ops[0] = 0xca;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case FLGNZ:					/* JP NZ,nn */
@@ -426,6 +464,7 @@ op_jp(void)
 			ops[0] = 0xc2;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case FLGPE:					/* JP PE,nn */
@@ -435,6 +474,7 @@ op_jp(void)
 			ops[0] = 0xea;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case FLGPO:					/* JP PO,nn */
@@ -444,6 +484,7 @@ op_jp(void)
 			ops[0] = 0xe2;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case FLGM:					/* JP M,nn */
@@ -453,6 +494,7 @@ op_jp(void)
 			ops[0] = 0xfa;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case FLGP:					/* JP P,nn */
@@ -462,6 +504,7 @@ op_jp(void)
 			ops[0] = 0xf2;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case REGIHL:					/* JP (HL) */
@@ -485,6 +528,7 @@ op_jp(void)
 			ops[0] = 0xc3;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -507,40 +551,44 @@ int
 op_jr(void)
 {
 	char	*p1, *p2;
+	int	 reg;
 
-	if (pass == 1) {				/* PASS 1 */
-		if (*label)
-			put_label();
-	} else {					/* PASS 2 */
-		p1 = operand;
-		p2 = tmp;
-		while (*p1 != ',' && *p1 != '\0')
-			*p2++ = *p1++;
-		*p2 = '\0';
-		switch (get_reg(tmp)) {
+	if ((pass == 1) && *label)
+		put_label();
+	p1 = operand;
+	p2 = tmp;
+	while (*p1 != ',' && *p1 != '\0')
+		*p2++ = *p1++;
+	*p2 = '\0';
+	reg = get_reg(tmp);
+	if (relax_flag && (reg == NOREG || reg == REGC || reg == FLGNC ||
+	    reg == FLGZ || reg == FLGNZ))
+		return (op_relax(reg, 2));
+	if (pass == 2) {				/* PASS 2 */
+		switch (reg) {
 		case REGC:				/* JR C,n */
 			ops[0] = 0x38;
 			ops[1] =
-			    chk_v2(eval(strchr(operand, ',') + 1) - pc - 2);
+			    chk_v2(eval_pc(strchr(operand, ',') + 1) - 2);
 			break;
 		case FLGNC:				/* JR NC,n */
 			ops[0] = 0x30;
 			ops[1] =
-			    chk_v2(eval(strchr(operand, ',') + 1) - pc - 2);
+			    chk_v2(eval_pc(strchr(operand, ',') + 1) - 2);
 			break;
 		case FLGZ:				/* JR Z,n */
 			ops[0] = 0x28;
 			ops[1] =
-			    chk_v2(eval(strchr(operand, ',') + 1) - pc - 2);
+			    chk_v2(eval_pc(strchr(operand, ',') + 1) - 2);
 			break;
 		case FLGNZ:				/* JR NZ,n */
 			ops[0] = 0x20;
 			ops[1] =
-			    chk_v2(eval(strchr(operand, ',') + 1) - pc - 2);
+			    chk_v2(eval_pc(strchr(operand, ',') + 1) - 2);
 			break;
 		case NOREG:				/* JR n */
 			ops[0] = 0x18;
-			ops[1] = chk_v2(eval(operand) - pc - 2);
+			ops[1] = chk_v2(eval_pc(operand) - 2);
 			break;
 		case NOOPERA:				/* missing operand */
 			ops[0] = 0;
@@ -556,6 +604,69 @@ op_jr(void)
 	return (2);
 }
 
+/*
+ *	JP or JR with -j: JR if the target is in range, else JP
+ *
+ *	Input: condition, NOREG if none
+ *	       length of the instruction as written, JP or JR
+ *
+ *	Output: length of the instruction
+ */
+static int
+op_relax(const int cond, const int len)
+{
+	const char	*target;
+	int		 i, jr, jp;
+
+	if (cond == NOREG)
+		target = operand;
+	else if ((target = strchr(operand, ',')) != NULL)
+		target++;
+	else {					/* missing target */
+		if (pass == 2) {
+			ops[0] = ops[1] = ops[2] = 0;
+			asmerr(E_MISOPE);
+		}
+		return (len);
+	}
+	switch (cond) {
+	case REGC:
+		jr = 0x38;
+		jp = 0xda;
+		break;
+	case FLGNC:
+		jr = 0x30;
+		jp = 0xd2;
+		break;
+	case FLGZ:
+		jr = 0x28;
+		jp = 0xca;
+		break;
+	case FLGNZ:
+		jr = 0x20;
+		jp = 0xc2;
+		break;
+	default:
+		jr = 0x18;
+		jp = 0xc3;
+	}
+	if (rlx_long(target)) {
+		if (pass == 2) {
+			i = eval(target);
+			ops[0] = jp;
+			ops[1] = i & 0xff;
+			ops[2] = i >> 8;
+			obj_reloc(1);
+		}
+		return (3);
+	}
+	if (pass == 2) {
+		ops[0] = jr;
+		ops[1] = chk_v2(eval_pc(target) - 2);
+	}
+	return (2);
+}
+
 /*
  *	DJNZ
  */
@@ -567,7 +678,7 @@ op_djnz(void)
 			put_label();
 	} else {					/* PASS 2 */
 		ops[0] = 0x10;
-		ops[1] = chk_v2(eval(operand) - pc - 2);
+		ops[1] = chk_v2(eval_pc(operand) - 2);
 	}
 	return (2);
 }
@@ -579,7 +690,7 @@ int
 op_ld(void)
 {
 	char	*p1, *p2;
-	int	 len;
+	int	 len, op;
 
 	if ((pass == 1) && *label)
 		put_label();
@@ -588,7 +699,7 @@ op_ld(void)
 	while (*p1 != ',' && *p1 != '\0')
 		*p2++ = *p1++;
 	*p2 = '\0';
-	switch (get_reg(tmp)) {
+	switch (op = get_reg(tmp)) {
 	case REGA:					/* LD A,? */
 		len = lda();
 		break;
@@ -610,6 +721,12 @@ op_ld(void)
 	case REGL:					/* LD L,? */
 		len = ldl();
 		break;
+	case REGIXH:					/* LD IXH,? */
+	case REGIXL:					/* LD IXL,? */
+	case REGIYH:					/* LD IYH,? */
+	case REGIYL:					/* LD IYL,? */
+		len = ldhalf(op);
+		break;
 	case REGI:					/* LD I,A */
 		if (get_reg(get_second(operand)) == REGA) {
 			len = 2;
@@ -716,6 +833,14 @@ lda(void)
 		len = 1;
 		ops[0] = 0x78 + op;
 		break;
+	case REGIXH:					/* LD A,IXH */
+	case REGIXL:					/* LD A,IXL */
+	case REGIYH:					/* LD A,IYH */
+	case REGIYL:					/* LD A,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x78 + half_reg(op);
+		break;
 	case REGI:					/* LD A,I */
 		len = 2;
 		ops[0] = 0xed;
@@ -760,6 +885,7 @@ lda(void)
 				ops[0] = 0x3a;
 				ops[1] = i & 255;
 				ops[2] = i >> 8;
+				obj_reloc(1);
 			}
 			break;
 		}
@@ -804,6 +930,14 @@ ldb(void)
 		len = 1;
 		ops[0] = 0x40 + op;
 		break;
+	case REGIXH:					/* LD B,IXH */
+	case REGIXL:					/* LD B,IXL */
+	case REGIYH:					/* LD B,IYH */
+	case REGIYL:					/* LD B,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x40 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(p, "(IX+", 4) == 0) {	/* LD B,(IX+d) */
 			len = 3;
@@ -864,6 +998,14 @@ ldc(void)
 		len = 1;
 		ops[0] = 0x48 + op;
 		break;
+	case REGIXH:					/* LD C,IXH */
+	case REGIXL:					/* LD C,IXL */
+	case REGIYH:					/* LD C,IYH */
+	case REGIYL:					/* LD C,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x48 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(p, "(IX+", 4) == 0) {	/* LD C,(IX+d) */
 			len = 3;
@@ -924,6 +1066,14 @@ ldd(void)
 		len = 1;
 		ops[0] = 0x50 + op;
 		break;
+	case REGIXH:					/* LD D,IXH */
+	case REGIXL:					/* LD D,IXL */
+	case REGIYH:					/* LD D,IYH */
+	case REGIYL:					/* LD D,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x50 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(p, "(IX+", 4) == 0) {	/* LD D,(IX+d) */
 			len = 3;
@@ -984,6 +1134,14 @@ lde(void)
 		len = 1;
 		ops[0] = 0x58 + op;
 		break;
+	case REGIXH:					/* LD E,IXH */
+	case REGIXL:					/* LD E,IXL */
+	case REGIYH:					/* LD E,IYH */
+	case REGIYL:					/* LD E,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x58 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(p, "(IX+", 4) == 0) {	/* LD E,(IX+d) */
 			len = 3;
@@ -1142,6 +1300,61 @@ ldl(void)
 	return (len);
 }
 
+/*
+ *	LD IXH,? LD IXL,? LD IYH,? LD IYL,? undocumented
+ */
+static int
+ldhalf(const int reg)
+{
+	char	*p;
+	int	 len, op;
+
+	p = get_second(operand);
+	switch (op = get_reg(p)) {
+	case REGA:					/* LD IXH,A */
+	case REGB:					/* LD IXH,B */
+	case REGC:					/* LD IXH,C */
+	case REGD:					/* LD IXH,D */
+	case REGE:					/* LD IXH,E */
+		len = 2;
+		ops[0] = half_pfx(reg);
+		ops[1] = 0x40 + (half_reg(reg) << 3) + op;
+		break;
+	case REGIXH:					/* LD IXH,IXH */
+	case REGIXL:					/* LD IXH,IXL */
+	case REGIYH:					/* LD IYH,IYH */
+	case REGIYL:					/* LD IYH,IYL */
+		if (half_pfx(op) != half_pfx(reg)) {
+			len = 1;		/* can't mix IX and IY */
+			ops[0] = 0;
+			asmerr(E_ILLOPE);
+			break;
+		}
+		len = 2;
+		ops[0] = half_pfx(reg);
+		ops[1] = 0x40 + (half_reg(reg) << 3) + half_reg(op);
+		break;
+	case NOREG:					/* LD IXH,n */
+		len = 3;
+		if (pass == 2) {
+			ops[0] = half_pfx(reg);
+			ops[1] = 0x06 + (half_reg(reg) << 3);
+			ops[2] = chk_v1(eval(p));
+		}
+		break;
+	case NOOPERA:					/* missing operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_MISOPE);
+		break;
+	default:					/* invalid operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_ILLOPE);
+	}
+	return (len);
+}
+
 /*
  *	LD BC,?
  */
@@ -1162,6 +1375,7 @@ ldbc(void)
 				ops[1] = 0x4b;
 				ops[2] = i & 0xff;
 				ops[3] = i >> 8;
+				obj_reloc(2);
 			}
 			break;
 		}
@@ -1171,6 +1385,7 @@ ldbc(void)
 			ops[0] = 0x01;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -1206,6 +1421,7 @@ ldde(void)
 				ops[1] = 0x5b;
 				ops[2] = i & 0xff;
 				ops[3] = i >> 8;
+				obj_reloc(2);
 			}
 			break;
 		}
@@ -1215,6 +1431,7 @@ ldde(void)
 			ops[0] = 0x11;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -1249,6 +1466,7 @@ ldhl(void)
 				ops[0] = 0x2a;
 				ops[1] = i & 0xff;
 				ops[2] = i >> 8;
+				obj_reloc(1);
 			}
 			break;
 		}
@@ -1258,6 +1476,7 @@ ldhl(void)
 			ops[0] = 0x21;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -1293,6 +1512,7 @@ ldix(void)
 				ops[1] = 0x2a;
 				ops[2] = i & 0xff;
 				ops[3] = i >> 8;
+				obj_reloc(2);
 			}
 			break;
 		}
@@ -1303,6 +1523,7 @@ ldix(void)
 			ops[1] = 0x21;
 			ops[2] = i & 0xff;
 			ops[3] = i >> 8;
+			obj_reloc(2);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -1338,6 +1559,7 @@ ldiy(void)
 				ops[1] = 0x2a;
 				ops[2] = i & 0xff;
 				ops[3] = i >> 8;
+				obj_reloc(2);
 			}
 			break;
 		}
@@ -1348,6 +1570,7 @@ ldiy(void)
 			ops[1] = 0x21;
 			ops[2] = i & 0xff;
 			ops[3] = i >> 8;
+			obj_reloc(2);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -1397,6 +1620,7 @@ ldsp(void)
 				ops[1] = 0x7b;
 				ops[2] = i & 0xff;
 				ops[3] = i >> 8;
+				obj_reloc(2);
 			}
 			break;
 		}
@@ -1406,6 +1630,7 @@ ldsp(void)
 			ops[0] = 0x31;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -1574,6 +1799,7 @@ ldinn(void)
 			ops[0] = 0x32;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case REGBC:					/* LD (nn),BC */
@@ -1584,6 +1810,7 @@ ldinn(void)
 			ops[1] = 0x43;
 			ops[2] = i & 0xff;
 			ops[3] = i >> 8;
+			obj_reloc(2);
 		}
 		break;
 	case REGDE:					/* LD (nn),DE */
@@ -1594,6 +1821,7 @@ ldinn(void)
 			ops[1] = 0x53;
 			ops[2] = i & 0xff;
 			ops[3] = i >> 8;
+			obj_reloc(2);
 		}
 		break;
 	case REGHL:					/* LD (nn),HL */
@@ -1603,6 +1831,7 @@ ldinn(void)
 			ops[0] = 0x22;
 			ops[1] = i & 0xff;
 			ops[2] = i >> 8;
+			obj_reloc(1);
 		}
 		break;
 	case REGSP:					/* LD (nn),SP */
@@ -1613,6 +1842,7 @@ ldinn(void)
 			ops[1] = 0x73;
 			ops[2] = i & 0xff;
 			ops[3] = i >> 8;
+			obj_reloc(2);
 		}
 		break;
 	case REGIX:					/* LD (nn),IX */
@@ -1623,6 +1853,7 @@ ldinn(void)
 			ops[1] = 0x22;
 			ops[2] = i & 0xff;
 			ops[3] = i >> 8;
+			obj_reloc(2);
 		}
 		break;
 	case REGIY:					/* LD (nn),IY */
@@ -1633,6 +1864,7 @@ ldinn(void)
 			ops[1] = 0x22;
 			ops[2] = i & 0xff;
 			ops[3] = i >> 8;
+			obj_reloc(2);
 		}
 		break;
 	case NOOPERA:					/* missing operand */
@@ -1655,7 +1887,7 @@ int
 op_add(void)
 {
 	char	*p1, *p2;
-	int	 len;
+	int	 len, op, n;
 
 	if ((pass == 1) && *label)
 		put_label();
@@ -1664,12 +1896,20 @@ op_add(void)
 	while (*p1 != ',' && *p1 != '\0')
 		*p2++ = *p1++;
 	*p2 = '\0';
-	switch (get_reg(tmp)) {
+	switch (op = get_reg(tmp)) {
 	case REGA:					/* ADD A,? */
 		len = adda();
 		break;
 	case REGHL:					/* ADD HL,? */
-		len = addhl();
+		n = get_reg(get_second(operand));
+		if (cpu_type == CPUZ80N && (n == REGA || n == NOREG))
+			len = addrr(op);		/* Z80N */
+		else
+			len = addhl();
+		break;
+	case REGBC:					/* ADD BC,? Z80N */
+	case REGDE:					/* ADD DE,? Z80N */
+		len = addrr(op);
 		break;
 	case REGIX:					/* ADD IX,? */
 		len = addix();
@@ -1712,6 +1952,14 @@ adda(void)
 		len = 1;
 		ops[0] = 0x80 + op;
 		break;
+	case REGIXH:					/* ADD A,IXH */
+	case REGIXL:					/* ADD A,IXL */
+	case REGIYH:					/* ADD A,IYH */
+	case REGIYL:					/* ADD A,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x80 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(p, "(IX+", 4) == 0) {
 			len = 3;			/* ADD A,(IX+d) */
@@ -1780,6 +2028,53 @@ addhl(void)
 	return (1);
 }
 
+/*
+ *	ADD HL,? ADD DE,? ADD BC,? Z80N
+ */
+static int
+addrr(const int reg)
+{
+	char	*p;
+	int	 i, len, op;
+
+	p = get_second(operand);
+	op = (reg == REGHL) ? 0 : (reg == REGDE) ? 1 : 2;
+	if (cpu_type != CPUZ80N) {			/* invalid operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_ILLOPE);
+		return (len);
+	}
+	switch (get_reg(p)) {
+	case REGA:					/* ADD HL,A */
+		len = 2;
+		ops[0] = 0xed;
+		ops[1] = 0x31 + op;
+		break;
+	case NOREG:					/* ADD HL,nn */
+		len = 4;
+		if (pass == 2) {
+			i = eval(p);
+			ops[0] = 0xed;
+			ops[1] = 0x34 + op;
+			ops[2] = i & 0xff;
+			ops[3] = (i >> 8) & 0xff;
+			obj_reloc(2);
+		}
+		break;
+	case NOOPERA:					/* missing operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_MISOPE);
+		break;
+	default:					/* invalid operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_ILLOPE);
+	}
+	return (len);
+}
+
 /*
  *	ADD IX,?
  */
@@ -1910,6 +2205,14 @@ adca(void)
 		len = 1;
 		ops[0] = 0x88 + op;
 		break;
+	case REGIXH:					/* ADC A,IXH */
+	case REGIXL:					/* ADC A,IXL */
+	case REGIYH:					/* ADC A,IYH */
+	case REGIYL:					/* ADC A,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x88 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(p, "(IX+", 4) == 0) {
 			len = 3;			/* ADC A,(IX+d) */
@@ -2004,6 +2307,14 @@ op_sub(void)
 		len = 1;
 		ops[0] = 0x90 + op;
 		break;
+	case REGIXH:					/* SUB IXH */
+	case REGIXL:					/* SUB IXL */
+	case REGIYH:					/* SUB IYH */
+	case REGIYL:					/* SUB IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x90 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(operand, "(IX+", 4) == 0) {
 			len = 3;			/* SUB (IX+d) */
@@ -2100,6 +2411,14 @@ sbca(void)
 		len = 1;
 		ops[0] = 0x98 + op;
 		break;
+	case REGIXH:					/* SBC A,IXH */
+	case REGIXL:					/* SBC A,IXL */
+	case REGIYH:					/* SBC A,IYH */
+	case REGIYL:					/* SBC A,IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x98 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(p, "(IX+", 4) == 0) {
 			len = 3;			/* SBC A,(IX+d) */
@@ -2194,6 +2513,14 @@ op_inc(void)
 		len = 1;
 		ops[0] = 0x04 + (op << 3);
 		break;
+	case REGIXH:					/* INC IXH */
+	case REGIXL:					/* INC IXL */
+	case REGIYH:					/* INC IYH */
+	case REGIYL:					/* INC IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x04 + (half_reg(op) << 3);
+		break;
 	case REGBC:					/* INC BC */
 		len = 1;
 		ops[0] = 0x03;
@@ -2278,6 +2605,14 @@ op_dec(void)
 		len = 1;
 		ops[0] = 0x05 + (op << 3);
 		break;
+	case REGIXH:					/* DEC IXH */
+	case REGIXL:					/* DEC IXL */
+	case REGIYH:					/* DEC IYH */
+	case REGIYL:					/* DEC IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0x05 + (half_reg(op) << 3);
+		break;
 	case REGBC:					/* DEC BC */
 		len = 1;
 		ops[0] = 0x0b;
@@ -2362,6 +2697,14 @@ op_or(void)
 		len = 1;
 		ops[0] = 0xb0 + op;
 		break;
+	case REGIXH:					/* OR IXH */
+	case REGIXL:					/* OR IXL */
+	case REGIYH:					/* OR IYH */
+	case REGIYL:					/* OR IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0xb0 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(operand, "(IX+", 4) == 0) {
 			len = 3;			/* OR (IX+d) */
@@ -2422,6 +2765,14 @@ op_xor(void)
 		len = 1;
 		ops[0] = 0xa8 + op;
 		break;
+	case REGIXH:					/* XOR IXH */
+	case REGIXL:					/* XOR IXL */
+	case REGIYH:					/* XOR IYH */
+	case REGIYL:					/* XOR IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0xa8 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(operand, "(IX+", 4) == 0) {
 			len = 3;			/* XOR (IX+d) */
@@ -2482,6 +2833,14 @@ op_and(void)
 		len = 1;
 		ops[0] = 0xa0 + op;
 		break;
+	case REGIXH:					/* AND IXH */
+	case REGIXL:					/* AND IXL */
+	case REGIYH:					/* AND IYH */
+	case REGIYL:					/* AND IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0xa0 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(operand, "(IX+", 4) == 0) {
 			len = 3;			/* AND (IX+d) */
@@ -2542,6 +2901,14 @@ op_cp(void)
 		len = 1;
 		ops[0] = 0xb8 + op;
 		break;
+	case REGIXH:					/* CP IXH */
+	case REGIXL:					/* CP IXL */
+	case REGIYH:					/* CP IYH */
+	case REGIYL:					/* CP IYL */
+		len = 2;
+		ops[0] = half_pfx(op);
+		ops[1] = 0xb8 + half_reg(op);
+		break;
 	case NOREG:					/* operand isn't reg */
 		if (strncmp(operand, "(IX+", 4) == 0) {
 			len = 3;			/* CP (IX+d) */
@@ -2611,7 +2978,7 @@ op_rl(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x16;
+				ops[3] = 0x10 + idx_copy(operand);
 			}
 		} else if (strncmp(operand, "(IY+", 4) == 0) {
 			len = 4;			/* RL (IY+d) */
@@ -2620,7 +2987,7 @@ op_rl(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x16;
+				ops[3] = 0x10 + idx_copy(operand);
 			}
 		} else {
 			len = 1;
@@ -2672,7 +3039,7 @@ op_rr(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x1e;
+				ops[3] = 0x18 + idx_copy(operand);
 			}
 		} else if (strncmp(operand, "(IY+", 4) == 0) {
 			len = 4;			/* RR (IY+d) */
@@ -2681,7 +3048,7 @@ op_rr(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x1e;
+				ops[3] = 0x18 + idx_copy(operand);
 			}
 		} else {
 			len = 1;
@@ -2733,7 +3100,7 @@ op_sla(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x26;
+				ops[3] = 0x20 + idx_copy(operand);
 			}
 		} else if (strncmp(operand, "(IY+", 4) == 0) {
 			len = 4;			/* SLA (IY+d) */
@@ -2742,7 +3109,7 @@ op_sla(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x26;
+				ops[3] = 0x20 + idx_copy(operand);
 			}
 		} else {
 			len = 1;
@@ -2794,7 +3161,7 @@ op_sra(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x2e;
+				ops[3] = 0x28 + idx_copy(operand);
 			}
 		} else if (strncmp(operand, "(IY+", 4) == 0) {
 			len = 4;			/* SRA (IY+d) */
@@ -2803,7 +3170,7 @@ op_sra(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x2e;
+				ops[3] = 0x28 + idx_copy(operand);
 			}
 		} else {
 			len = 1;
@@ -2855,7 +3222,7 @@ op_srl(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x3e;
+				ops[3] = 0x38 + idx_copy(operand);
 			}
 		} else if (strncmp(operand, "(IY+", 4) == 0) {
 			len = 4;			/* SRL (IY+d) */
@@ -2864,7 +3231,68 @@ op_srl(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x3e;
+				ops[3] = 0x38 + idx_copy(operand);
+			}
+		} else {
+			len = 1;
+			ops[0] = 0;
+			asmerr(E_ILLOPE);
+		}
+		break;
+	case NOOPERA:					/* missing operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_MISOPE);
+		break;
+	default:					/* invalid operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_ILLOPE);
+	}
+	return (len);
+}
+
+/*
+ *	SLL, undocumented
+ */
+int
+op_sll(void)
+{
+	int	len, op;
+
+	if ((pass == 1) && *label)
+		put_label();
+	switch (op = get_reg(operand)) {
+	case REGA:					/* SLL A */
+	case REGB:					/* SLL B */
+	case REGC:					/* SLL C */
+	case REGD:					/* SLL D */
+	case REGE:					/* SLL E */
+	case REGH:					/* SLL H */
+	case REGL:					/* SLL L */
+	case REGIHL:					/* SLL (HL) */
+		len = 2;
+		ops[0] = 0xcb;
+		ops[1] = 0x30 + op;
+		break;
+	case NOREG:					/* operand isn't reg */
+		if (strncmp(operand, "(IX+", 4) == 0) {
+			len = 4;			/* SLL (IX+d) */
+			if (pass == 2) {
+				ops[0] = 0xdd;
+				ops[1] = 0xcb;
+				ops[2] =
+				    chk_v2(calc_val(strchr(operand, '+') + 1));
+				ops[3] = 0x30 + idx_copy(operand);
+			}
+		} else if (strncmp(operand, "(IY+", 4) == 0) {
+			len = 4;			/* SLL (IY+d) */
+			if (pass == 2) {
+				ops[0] = 0xfd;
+				ops[1] = 0xcb;
+				ops[2] =
+				    chk_v2(calc_val(strchr(operand, '+') + 1));
+				ops[3] = 0x30 + idx_copy(operand);
 			}
 		} else {
 			len = 1;
@@ -2916,7 +3344,7 @@ op_rlc(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x06;
+				ops[3] = idx_copy(operand);
 			}
 		} else if (strncmp(operand, "(IY+", 4) == 0) {
 			len = 4;			/* RLC (IY+d) */
@@ -2925,7 +3353,7 @@ op_rlc(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x06;
+				ops[3] = idx_copy(operand);
 			}
 		} else {
 			len = 1;
@@ -2977,7 +3405,7 @@ op_rrc(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x0e;
+				ops[3] = 0x08 + idx_copy(operand);
 			}
 		} else if (strncmp(operand, "(IY+", 4) == 0) {
 			len = 4;			/* RRC (IY+d) */
@@ -2986,7 +3414,7 @@ op_rrc(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x0e;
+				ops[3] = 0x08 + idx_copy(operand);
 			}
 		} else {
 			len = 1;
@@ -3031,6 +3459,17 @@ op_out(void)
 				ops[0] = 0xed;
 				ops[1] = 0x41 + (op << 3);
 				break;
+			case NOREG:			/* OUT (C),0 */
+				if (undoc_flag &&
+				    strcmp(get_second(operand), "0") == 0) {
+					ops[0] = 0xed;
+					ops[1] = 0x71;
+					break;
+				}
+				ops[0] = 0;
+				ops[1] = 0;
+				asmerr(E_ILLOPE);
+				break;
 			case NOOPERA:			/* missing operand */
 				ops[0] = 0;
 				ops[1] = 0;
@@ -3087,6 +3526,17 @@ op_in(void)
 			ops[0] = 0xed;
 			ops[1] = 0x40 + (op << 3);
 			break;
+		case NOREG:				/* IN F,(C) */
+			if (undoc_flag && (strcmp(operand, "(C)") == 0 ||
+			    strcmp(operand, "F,(C)") == 0)) {
+				ops[0] = 0xed;
+				ops[1] = 0x70;
+				break;
+			}
+			ops[0] = 0;
+			ops[1] = 0;
+			asmerr(E_ILLOPE);
+			break;
 		default:				/* invalid operand */
 			ops[0] = 0;
 			ops[1] = 0;
@@ -3139,7 +3589,7 @@ op_set(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0xc6 + i * 8;
+				ops[3] = 0xc0 + i * 8 + idx_copy(p1);
 			}
 		} else if (strncmp(p1, "(IY+", 4) == 0) {
 			len = 4;			/* SET n,(IY+d) */
@@ -3148,7 +3598,7 @@ op_set(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0xc6 + i * 8;
+				ops[3] = 0xc0 + i * 8 + idx_copy(p1);
 			}
 		} else {
 			ops[1] = 0;
@@ -3209,7 +3659,7 @@ op_res(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x86 + i * 8;
+				ops[3] = 0x80 + i * 8 + idx_copy(p1);
 			}
 		} else if (strncmp(p1, "(IY+", 4) == 0) {
 			len = 4;			/* RES n,(IY+d) */
@@ -3218,7 +3668,7 @@ op_res(void)
 				ops[1] = 0xcb;
 				ops[2] =
 				    chk_v2(calc_val(strchr(operand, '+') + 1));
-				ops[3] = 0x86 + i * 8;
+				ops[3] = 0x80 + i * 8 + idx_copy(p1);
 			}
 		} else {
 			ops[1] = 0;
@@ -3306,6 +3756,300 @@ op_bit(void)
 	return (len);
 }
 
+/*
+ *	MLT, Z180
+ */
+int
+op_mlt(void)
+{
+	if (pass == 1) {				/* PASS 1 */
+		if (*label)
+			put_label();
+	} else {					/* PASS 2 */
+		ops[0] = 0xed;
+		switch (get_reg(operand)) {
+		case REGBC:				/* MLT BC */
+			ops[1] = 0x4c;
+			break;
+		case REGDE:				/* MLT DE */
+			ops[1] = 0x5c;
+			break;
+		case REGHL:				/* MLT HL */
+			ops[1] = 0x6c;
+			break;
+		case REGSP:				/* MLT SP */
+			ops[1] = 0x7c;
+			break;
+		case NOOPERA:				/* missing operand */
+			ops[0] = 0;
+			ops[1] = 0;
+			asmerr(E_MISOPE);
+			break;
+		default:				/* invalid operand */
+			ops[0] = 0;
+			ops[1] = 0;
+			asmerr(E_ILLOPE);
+		}
+	}
+	return (2);
+}
+
+/*
+ *	TST, Z180
+ */
+int
+op_tst(void)
+{
+	int	len, op;
+
+	if ((pass == 1) && *label)
+		put_label();
+	switch (op = get_reg(operand)) {
+	case REGA:					/* TST A */
+	case REGB:					/* TST B */
+	case REGC:					/* TST C */
+	case REGD:					/* TST D */
+	case REGE:					/* TST E */
+	case REGH:					/* TST H */
+	case REGL:					/* TST L */
+	case REGIHL:					/* TST (HL) */
+		len = 2;
+		ops[0] = 0xed;
+		ops[1] = 0x04 + (op << 3);
+		break;
+	case NOREG:					/* TST n */
+		len = 3;
+		if (pass == 2) {
+			ops[0] = 0xed;
+			ops[1] = 0x64;
+			ops[2] = chk_v1(eval(operand));
+		}
+		break;
+	case NOOPERA:					/* missing operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_MISOPE);
+		break;
+	default:					/* invalid operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_ILLOPE);
+	}
+	return (len);
+}
+
+/*
+ *	TSTIO, Z180
+ */
+int
+op_tstio(void)
+{
+	if (pass == 1) {				/* PASS 1 */
+		if (*label)
+			put_label();
+	} else {					/* PASS 2 */
+		ops[0] = 0xed;				/* TSTIO n */
+		ops[1] = 0x74;
+		ops[2] = chk_v1(eval(operand));
+	}
+	return (3);
+}
+
+/*
+ *	IN0, Z180
+ */
+int
+op_in0(void)
+{
+	char	*p1, *p2;
+	int	 op;
+
+	if (pass == 1) {				/* PASS 1 */
+		if (*label)
+			put_label();
+	} else {					/* PASS 2 */
+		p1 = operand;
+		p2 = tmp;
+		while (*p1 != ',' && *p1 != '\0')
+			*p2++ = *p1++;
+		*p2 = '\0';
+		p1 = get_second(operand);
+		switch (op = get_reg(tmp)) {
+		case REGA:				/* IN0 A,(n) */
+		case REGB:				/* IN0 B,(n) */
+		case REGC:				/* IN0 C,(n) */
+		case REGD:				/* IN0 D,(n) */
+		case REGE:				/* IN0 E,(n) */
+		case REGH:				/* IN0 H,(n) */
+		case REGL:				/* IN0 L,(n) */
+			if (p1 != NULL && *p1 == '(') {
+				ops[0] = 0xed;
+				ops[1] = op << 3;
+				ops[2] = chk_v1(calc_val(p1 + 1));
+				break;
+			}
+			/* FALLTHROUGH */
+		default:				/* invalid operand */
+			ops[0] = 0;
+			ops[1] = 0;
+			ops[2] = 0;
+			asmerr(E_ILLOPE);
+		}
+	}
+	return (3);
+}
+
+/*
+ *	OUT0, Z180
+ */
+int
+op_out0(void)
+{
+	int	op;
+
+	if (pass == 1) {				/* PASS 1 */
+		if (*label)
+			put_label();
+	} else {					/* PASS 2 */
+		switch (op = get_reg(get_second(operand))) {
+		case REGA:				/* OUT0 (n),A */
+		case REGB:				/* OUT0 (n),B */
+		case REGC:				/* OUT0 (n),C */
+		case REGD:				/* OUT0 (n),D */
+		case REGE:				/* OUT0 (n),E */
+		case REGH:				/* OUT0 (n),H */
+		case REGL:				/* OUT0 (n),L */
+			if (*operand == '(') {
+				ops[0] = 0xed;
+				ops[1] = 0x01 + (op << 3);
+				ops[2] = chk_v1(calc_val(operand + 1));
+				break;
+			}
+			/* FALLTHROUGH */
+		default:				/* invalid operand */
+			ops[0] = 0;
+			ops[1] = 0;
+			ops[2] = 0;
+			asmerr(E_ILLOPE);
+		}
+	}
+	return (3);
+}
+
+/*
+ *	TEST, Z80N
+ */
+int
+op_ntest(void)
+{
+	if (pass == 1) {				/* PASS 1 */
+		if (*label)
+			put_label();
+	} else {					/* PASS 2 */
+		ops[0] = 0xed;				/* TEST n */
+		ops[1] = 0x27;
+		ops[2] = chk_v1(eval(operand));
+	}
+	return (3);
+}
+
+/*
+ *	NEXTREG, Z80N
+ */
+int
+op_nreg(void)
+{
+	char	*p1, *p2;
+	int	 len;
+
+	if ((pass == 1) && *label)
+		put_label();
+	p1 = operand;
+	p2 = tmp;
+	while (*p1 != ',' && *p1 != '\0')
+		*p2++ = *p1++;
+	*p2 = '\0';
+	switch (get_reg(p1 = get_second(operand))) {
+	case REGA:					/* NEXTREG n,A */
+		len = 3;
+		if (pass == 2) {
+			ops[0] = 0xed;
+			ops[1] = 0x92;
+			ops[2] = chk_v1(eval(tmp));
+		}
+		break;
+	case NOREG:					/* NEXTREG n,n */
+		len = 4;
+		if (pass == 2) {
+			ops[0] = 0xed;
+			ops[1] = 0x91;
+			ops[2] = chk_v1(eval(tmp));
+			ops[3] = chk_v1(eval(p1));
+		}
+		break;
+	case NOOPERA:					/* missing operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_MISOPE);
+		break;
+	default:					/* invalid operand */
+		len = 1;
+		ops[0] = 0;
+		asmerr(E_ILLOPE);
+	}
+	return (len);
+}
+
+/*
+ *	returns the prefix DD or FD for the undocumented
+ *	operands IXH, IXL, IYH and IYL
+ */
+static int
+half_pfx(const int reg)
+{
+	return ((reg == REGIXH || reg == REGIXL) ? 0xdd : 0xfd);
+}
+
+/*
+ *	returns the register H or L, which encodes the undocumented
+ *	operands IXH, IXL, IYH and IYL after the prefix
+ */
+static int
+half_reg(const int reg)
+{
+	return ((reg == REGIXH || reg == REGIYH) ? REGH : REGL);
+}
+
+/*
+ *	returns the register, which gets a copy of the result for
+ *	the undocumented DDCB and FDCB opcodes:
+ *	RLC (IX+d),B	SET n,(IY+d),A
+ *	without a register, or without option -U, (HL) is
+ *	returned for the documented opcodes
+ */
+static int
+idx_copy(const char * const s)
+{
+	const char	*p;
+	int		 op;
+
+	if (!undoc_flag || (p = strrchr(s, ')')) == NULL || *++p != ',')
+		return (REGIHL);
+	switch (op = get_reg(p + 1)) {
+	case REGA:
+	case REGB:
+	case REGC:
+	case REGD:
+	case REGE:
+	case REGH:
+	case REGL:
+		return (op);
+	default:
+		asmerr(E_ILLOPE);
+		return (REGIHL);
+	}
+}
+
 /*
  *	returns a pointer to the second operand for
  *	opcodes:	opcode destination,source
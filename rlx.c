@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the relaxation of jumps with -j
+ *	every JP and JR, that could be either, is a site; all sites start
+ *	as JR and pass 1 is repeated while the target of a JR turns out
+ *	to be out of range, which then becomes JP; as sites only grow,
+ *	this ends when the layout is stable
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zz80asm.h"
+
+/*
+ *	structure jump sites
+ */
+struct site {
+	char	*si_target;	/* target expression */
+	int	 si_pc;		/* address of the jump in last pass 1 */
+	int	 si_sect;	/* section of the address */
+	int	 si_long;	/* jump is a JP */
+};
+
+static struct site *sites;		/* jump sites in source order */
+static size_t	    nsites, ssites;	/* no. and size of sites */
+static size_t	    cursite;		/* next site in this pass */
+
+/*
+ *	start a pass at the first site
+ */
+void
+rlx_init(void)
+{
+	cursite = 0;
+}
+
+/*
+ *	next site: in pass 1 its address and target are kept
+ *
+ *	Input: target expression
+ *
+ *	Output: 1 the jump is a JP, 0 a JR
+ */
+int
+rlx_long(const char * const target)
+{
+	struct site	*sp;
+
+	if (cursite == nsites) {
+		if (pass == 2)
+			fatal(F_INTERN, "jump site missing in pass 1");
+		if (nsites == ssites)
+			sites = grow_tab(sites, &ssites, sizeof(struct site));
+		sp = &sites[nsites++];
+		sp->si_target = NULL;
+		sp->si_long = 0;
+	}
+	sp = &sites[cursite++];
+	if (pass == 1) {
+		free(sp->si_target);
+		if ((sp->si_target = strdup(target)) == NULL)
+			fatal(F_OUTMEM, "jump sites");
+		sp->si_pc = pc;
+		sp->si_sect = cursect;
+	}
+	return (sp->si_long);
+}
+
+/*
+ *	after pass 1, turn all JR's whose target isn't in range,
+ *	in the same section, into JP's
+ *
+ *	Output: no. of sites changed
+ */
+int
+rlx_check(void)
+{
+	size_t		 i;
+	int		 n, d, savepc, savesect;
+	struct site	*sp;
+
+	savepc = pc;
+	savesect = cursect;
+	for (n = 0, i = 0; i < nsites; i++) {
+		sp = &sites[i];
+		if (sp->si_long)
+			continue;
+		pc = sp->si_pc;
+		cursect = sp->si_sect;
+		d = eval_quiet(sp->si_target) - (pc + 2);
+		if (ev_late || ev_ext || ev_sect != cursect || d < -128 ||
+		    d > 127) {
+			sp->si_long = 1;
+			n++;
+		}
+	}
+	pc = savepc;
+	cursect = savesect;
+	if (ver_flag && n)
+		fprintf(stdout, "   Relax   %d jump(s) out of range\n", n);
+	return (n);
+}
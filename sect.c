@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for sections
+ *	the source may switch between named sections with SECTION, each
+ *	with its own program counter; after pass 1 the sections are placed
+ *	one after the other behind CODE, uninitialised sections last, and
+ *	the labels in them are moved to their final addresses; in a
+ *	relocatable object the placement is left to the linker
+ *	a section must not overlap CODE or another section
+ *	with -p, the gaps left by aligned sections are filled with
+ *	sections placed later otherwise
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zz80asm.h"
+
+static struct sect *sects;		/* sections, CODE first */
+static size_t	    nsects, ssects;	/* no. and size of sections */
+static size_t	    cur;		/* current section */
+
+static void	sect_set(const size_t);
+static void	sect_fill(int, const int, const int);
+static void	sect_place(struct sect * const, const int);
+static void	sect_where(struct sect * const);
+
+/*
+ *	start a pass in section CODE
+ */
+void
+sect_init(void)
+{
+	size_t	i;
+
+	if (nsects == 0)
+		sect_switch("CODE", 0);
+	for (i = 0; i < nsects; i++)
+		sects[i].sc_pc = (pass == 2 && out_form != OUTREL) ?
+		    sects[i].sc_base : 0;
+	sect_set(0);
+}
+
+/*
+ *	make section name the current section, it is created if
+ *	it doesn't exist yet
+ *
+ *	Input: name of section
+ *	       1 if the section is uninitialised, 0 if not known
+ */
+void
+sect_switch(const char * const name, const int bss)
+{
+	size_t	i;
+
+	if (nsects > 0)
+		sects[cur].sc_pc = pc;
+	for (i = 0; i < nsects; i++)
+		if (strcmp(sects[i].sc_name, name) == 0)
+			break;
+	if (i == nsects) {
+		if (nsects == ssects)
+			sects = grow_tab(sects, &ssects, sizeof(struct sect));
+		strlcpy(sects[i].sc_name, name, sizeof(sects[i].sc_name));
+		sects[i].sc_bss = bss || strcmp(name, "BSS") == 0;
+		sects[i].sc_org = -1;
+		sects[i].sc_align = 1;
+		sects[i].sc_pc = sects[i].sc_size = sects[i].sc_base = 0;
+		sects[i].sc_file = NULL;
+		sect_where(&sects[i]);
+		nsects++;
+	} else if (bss && !sects[i].sc_bss)
+		asmerr(E_ILLOPE);
+	sect_set(i);
+}
+
+/*
+ *	set current section, program counter and cursect:
+ *	labels are absolute in a placed section, which is CODE in
+ *	pass 1 and all sections in pass 2, otherwise relative to
+ *	section no. i + 1
+ */
+static void
+sect_set(const size_t i)
+{
+	cur = i;
+	pc = sects[i].sc_pc;
+	if (out_form == OUTREL)
+		cursect = (int)i + 1;
+	else
+		cursect = (pass == 1 && i > 0) ? (int)i + 1 : 0;
+}
+
+/*
+ *	new program counter for ORG in pass 1: an address in a section
+ *	not yet placed fixes the address of the section, if it is given
+ *	before any code
+ *
+ *	Input: value of the ORG expression
+ *
+ *	Output: new program counter, or -1 if the address is illegal
+ */
+int
+sect_org(const int addr)
+{
+	struct sect	*sp;
+
+	if (out_form == OUTREL || pass == 2)
+		return (addr);
+	if (ev_late || ev_ext || (ev_sect && ev_sect != cursect))
+		return (-1);
+	sp = &sects[cur];
+	if (cursect == 0) {		/* lowest address of CODE */
+		if (sp->sc_org < 0)
+			sp->sc_org = (pc > 0) ? 0 : addr;
+		else if (addr < sp->sc_org)
+			sp->sc_org = addr;
+		return (addr);
+	}
+	if (ev_sect)
+		return (addr);
+	if (sp->sc_org < 0) {
+		if (pc > 0)
+			return (-1);
+		sp->sc_org = addr;
+		sect_where(sp);
+	}
+	return (addr - sp->sc_org);
+}
+
+/*
+ *	alignment for ALIGN: a section not yet placed must be placed
+ *	at an address aligned the same way
+ *
+ *	Input: alignment, a power of 2
+ *
+ *	Output: no. of bytes up to the aligned address
+ */
+int
+sect_align(const int n)
+{
+	struct sect	*sp;
+	int		 a;
+
+	sp = &sects[cur];
+	a = pc;
+	if (cursect != 0) {
+		if (sp->sc_org >= 0 && out_form != OUTREL)
+			a += sp->sc_org;
+		else if (n > sp->sc_align)
+			sp->sc_align = n;
+	}
+	return ((n - (a & (n - 1))) & (n - 1));
+}
+
+/*
+ *	place the sections after pass 1 and move the labels in them
+ *	to their addresses
+ */
+void
+sect_layout(void)
+{
+	size_t		 i;
+	int		 bss, next, base, h;
+	struct sect	*sp;
+	struct sym	*np;
+
+	sects[cur].sc_pc = pc;
+	for (i = 0; i < nsects; i++)
+		sects[i].sc_size = sects[i].sc_pc;
+	if (out_form == OUTREL) {	/* only for the object buffer */
+		for (next = 0, i = 0; i < nsects; i++) {
+			sects[i].sc_base = next;
+			next += sects[i].sc_size;
+		}
+		return;
+	}
+	for (i = 1; i < nsects; i++)
+		sects[i].sc_base = -1;
+	next = sects[0].sc_size;	/* end address of CODE */
+	for (bss = 0; bss < 2; bss++)
+		for (i = 1; i < nsects; i++) {
+			sp = &sects[i];
+			if (sp->sc_bss != bss || sp->sc_base >= 0)
+				continue;
+			if (sp->sc_org >= 0)
+				base = sp->sc_org;
+			else {
+				base = ALIGNUP(next, sp->sc_align);
+				if (pack_flag)
+					sect_fill(next, base, bss);
+			}
+			sect_place(sp, base);
+			if (base + sp->sc_size > next)
+				next = base + sp->sc_size;
+		}
+	for (h = 0; h < HASHSIZE; h++)
+		for (np = symtab[h]; np != NULL; np = np->sym_next)
+			if (np->sym_sect > 0) {
+				np->sym_val += sects[np->sym_sect - 1].sc_base;
+				np->sym_sect = 0;
+			}
+}
+
+/*
+ *	fill the gap from address a up to address end with sections
+ *	not yet placed, each at the first address it fits
+ *
+ *	Input: start and end of the gap
+ *	       1 if the gap is between uninitialised sections
+ */
+static void
+sect_fill(int a, const int end, const int bss)
+{
+	size_t		 i;
+	int		 base;
+	struct sect	*sp;
+
+	for (i = 1; i < nsects && a < end; i++) {
+		sp = &sects[i];
+		if (sp->sc_bss != bss || sp->sc_base >= 0 || sp->sc_org >= 0)
+			continue;
+		base = ALIGNUP(a, sp->sc_align);
+		if (base + sp->sc_size > end)
+			continue;
+		sect_place(sp, base);
+		a = base + sp->sc_size;
+	}
+}
+
+/*
+ *	place section sp at address base, it must not overlap CODE
+ *	or a section placed before
+ */
+static void
+sect_place(struct sect * const sp, const int base)
+{
+	size_t		 i;
+	int		 lo, hi;
+	char		 arg[64];
+	struct sect	*tp;
+
+	sp->sc_base = base;
+	if (ver_flag)
+		fprintf(stdout, "   Place   %s %04X %04X\n", sp->sc_name,
+		    base & 0xffff, sp->sc_size & 0xffff);
+	for (i = 0; i < nsects && sp->sc_size > 0; i++) {
+		tp = &sects[i];
+		if (tp == sp || tp->sc_base < 0)
+			continue;
+		lo = (i == 0) ? ((tp->sc_org < 0) ? 0 : tp->sc_org) :
+		    tp->sc_base;
+		hi = (i == 0) ? tp->sc_size : tp->sc_base + tp->sc_size;
+		if (base < hi && lo < base + sp->sc_size) {
+			snprintf(arg, sizeof(arg), "%s %04X-%04X overlaps %s",
+			    sp->sc_name, base & 0xffff,
+			    (base + sp->sc_size - 1) & 0xffff, tp->sc_name);
+			asmerr_at(E_MEMOVR, sp->sc_file, sp->sc_line, arg);
+			return;
+		}
+	}
+}
+
+/*
+ *	remember the line of SECTION or ORG, that gave the address
+ *	of section sp, for the errors of the placement
+ */
+static void
+sect_where(struct sect * const sp)
+{
+	if (srcfn == NULL)		/* CODE */
+		return;
+	free(sp->sc_file);
+	if ((sp->sc_file = strdup(srcfn)) == NULL)
+		fatal(F_OUTMEM, "sections");
+	sp->sc_line = c_line;
+}
+
+/*
+ *	current section
+ *
+ *	Output: no. of the section, 0 for CODE
+ */
+size_t
+sect_cur(void)
+{
+	return (cur);
+}
+
+/*
+ *	check if the current section is uninitialised
+ */
+int
+sect_bss(void)
+{
+	return (nsects > 0 && sects[cur].sc_bss);
+}
+
+/*
+ *	section no. i
+ *
+ *	Output: section, or NULL if there is no such section
+ */
+struct sect *
+sect_get(const size_t i)
+{
+	return ((i < nsects) ? &sects[i] : NULL);
+}
+
+/*
+ *	position of offset off of the current section in the
+ *	buffer of a relocatable object, or the address if placed
+ */
+int
+sect_addr(const int off)
+{
+	if (out_form != OUTREL)
+		return (off & 0xffff);
+	return ((sects[cur].sc_base + off) & 0xffff);
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for reading source files
+ *	every file is read from disk only once and then kept in memory,
+ *	pass 2 and further INCLUDE's of the same file are served from the cache
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "zz80asm.h"
+
+/*
+ *	structure cached source files
+ */
+struct src {
+	struct	 src *src_next;	/* next entry */
+	char	*src_fn;	/* filename the file was first read as */
+	dev_t	 src_dev;	/* device of file */
+	ino_t	 src_ino;	/* inode of file */
+	time_t	 src_mtime;	/* modification time of file */
+	char	*src_buf;	/* contents of file */
+	size_t	 src_len;	/* length of contents */
+	uint64_t src_hash;	/* hash of contents */
+	int	 src_equ;	/* only EQU's and comments, 2 if $ used */
+	uint8_t	 src_pass;	/* last pass the file was read in */
+	int	 src_read;	/* file is an input of this run */
+};
+
+static struct src	*src_get(const char * const);
+static void		 src_add(struct src * const);
+static int		 equ_only(const char *, const char * const);
+
+static struct src	 *srctab;	/* cached source files */
+static struct src	**readtab;	/* inputs of this run in read order */
+static size_t		  readcnt;	/* no. of inputs of this run */
+static size_t		  readsize;	/* size of readtab */
+
+/*
+ *	open a source file for reading
+ *
+ *	Input: name of source file
+ *
+ *	Output: file pointer to the cached contents of the file
+ */
+FILE *
+src_open(const char * const fn)
+{
+	FILE		*fp;
+	struct src	*sp;
+
+	sp = src_get(fn);
+	sp->src_pass = pass;
+	src_add(sp);
+	if (sp->src_len == 0)		/* fmemopen() refuses empty buffers */
+		fp = fopen(fn, "r");
+	else
+		fp = fmemopen(sp->src_buf, sp->src_len, "r");
+	if (fp == NULL)
+		fatal(F_FOPEN, fn);
+	return (fp);
+}
+
+/*
+ *	check if an INCLUDE of a file can be skipped, this is the case
+ *	if the file was read already in this pass and either INCLUDE ONCE
+ *	was used or the file only defines constants with EQU
+ *
+ *	Input: name of source file
+ *	       flag for INCLUDE ONCE
+ *
+ *	Output: 1 skip file
+ *		0 include file
+ */
+int
+src_skip(const char * const fn, const int once)
+{
+	struct src	*sp;
+
+	sp = src_get(fn);
+	return (sp->src_pass == pass && (once || sp->src_equ));
+}
+
+/*
+ *	check if two filenames name the same source file, by device
+ *	and inode, for the recursion check of INCLUDE
+ *
+ *	Output: 1 same file
+ *		0 different files
+ */
+int
+src_same(const char * const fn1, const char * const fn2)
+{
+	struct src	*sp1, *sp2;
+
+	sp1 = src_get(fn1);
+	sp2 = src_get(fn2);
+	return (sp1->src_dev == sp2->src_dev && sp1->src_ino == sp2->src_ino);
+}
+
+/*
+ *	check if a source file only consists of EQU's and comments
+ *
+ *	Output: 1 only EQU's with absolute values
+ *		2 only EQU's, some relative to $
+ *		0 other statements found
+ */
+int
+src_equonly(const char * const fn)
+{
+	return (src_get(fn)->src_equ);
+}
+
+/*
+ *	hash of the contents of a source file
+ */
+uint64_t
+src_hash(const char * const fn)
+{
+	return (src_get(fn)->src_hash);
+}
+
+/*
+ *	mark a source file as read in this pass and as input of this run,
+ *	without reading it; used if the output is taken from the build
+ *	cache or the symbols from a precompiled image
+ */
+void
+src_mark(const char * const fn)
+{
+	struct src	*sp;
+
+	sp = src_get(fn);
+	sp->src_pass = pass;
+	src_add(sp);
+}
+
+/*
+ *	forget which files were read in this pass, to repeat it
+ */
+void
+src_rewind(void)
+{
+	struct src	*sp;
+
+	for (sp = srctab; sp != NULL; sp = sp->src_next)
+		sp->src_pass = 0;
+}
+
+/*
+ *	name of the n'th input file of this run
+ *
+ *	Output: filename, or NULL if less than n+1 files were read
+ */
+const char *
+src_name(const size_t n)
+{
+	if (n >= readcnt)
+		return (NULL);
+	return (readtab[n]->src_fn);
+}
+
+/*
+ *	write hash and name of all input files of this run
+ */
+void
+src_list(FILE * const fp)
+{
+	size_t	i;
+
+	for (i = 0; i < readcnt; i++)
+		fprintf(fp, "%016" PRIx64 " %s\n", readtab[i]->src_hash,
+		    readtab[i]->src_fn);
+}
+
+/*
+ *	add a source file to the inputs of this run
+ */
+static void
+src_add(struct src * const sp)
+{
+	size_t		  newsize;
+	struct src	**newtab;
+
+	if (sp->src_read)
+		return;
+	if (readcnt == readsize) {
+		newsize = readsize + SYMINC;
+		if (newsize > SIZE_MAX / sizeof(struct src *))
+			fatal(F_INTERN, "overflow");
+		newtab = realloc(readtab, newsize * sizeof(struct src *));
+		if (newtab == NULL)
+			fatal(F_OUTMEM, "source cache");
+		readtab = newtab;
+		readsize = newsize;
+	}
+	readtab[readcnt++] = sp;
+	sp->src_read = 1;
+}
+
+/*
+ *	search a source file in the cache, read it into the cache
+ *	if not found
+ *
+ *	Input: name of source file
+ *
+ *	Output: pointer to cache entry
+ */
+static struct src *
+src_get(const char * const fn)
+{
+	FILE		*fp;
+	struct src	*sp;
+	struct stat	 st;
+
+	if (stat(fn, &st) == -1)
+		fatal(F_FOPEN, fn);
+	for (sp = srctab; sp != NULL; sp = sp->src_next)
+		if (sp->src_ino == st.st_ino && sp->src_dev == st.st_dev &&
+		    sp->src_mtime == st.st_mtime)
+			return (sp);
+	if ((fp = fopen(fn, "r")) == NULL)
+		fatal(F_FOPEN, fn);
+	if ((sp = calloc(1, sizeof(struct src))) == NULL)
+		fatal(F_OUTMEM, "source cache");
+	if ((sp->src_buf = malloc((size_t)st.st_size + 1)) == NULL)
+		fatal(F_OUTMEM, "source cache");
+	sp->src_len = fread(sp->src_buf, 1, (size_t)st.st_size, fp);
+	sp->src_buf[sp->src_len] = '\0';
+	fclose(fp);
+	sp->src_dev = st.st_dev;
+	sp->src_ino = st.st_ino;
+	sp->src_mtime = st.st_mtime;
+	if ((sp->src_fn = strdup(fn)) == NULL)
+		fatal(F_OUTMEM, "source cache");
+	sp->src_hash = fnv_hash(0, sp->src_buf, sp->src_len);
+	sp->src_equ = equ_only(sp->src_buf, sp->src_buf + sp->src_len);
+	sp->src_next = srctab;
+	srctab = sp;
+	return (sp);
+}
+
+/*
+ *	check if a source only consists of EQU's, comments and empty lines
+ *
+ *	Input: pointer to start and end of source text
+ *
+ *	Output: 1 only EQU's
+ *		2 only EQU's, some use the program counter $
+ *		0 other statements found
+ */
+static int
+equ_only(const char *s, const char * const end)
+{
+	const char	*w;
+	int		 lab, str, ret;
+
+	ret = 1;
+	while (s < end) {
+		if (*s != LINCOM) {
+			lab = 0;
+			while (s < end && !isspace((int)*s) && *s != COMMENT &&
+			    *s != LABSEP) {
+				s++;
+				lab = 1;
+			}
+			if (s < end && *s == LABSEP)
+				s++;
+			while (s < end && (*s == ' ' || *s == '\t'))
+				s++;
+			w = s;
+			while (s < end && !isspace((int)*s) && *s != COMMENT)
+				s++;
+			if (s == w) {
+				if (lab)	/* label defines an address */
+					return (0);
+			} else if (s - w != 3 || strncasecmp(w, "EQU", 3) != 0)
+				return (0);
+			for (str = 0; s < end && *s != '\n'; s++) {
+				if (*s == STRSEP)
+					str = !str;
+				else if (!str && *s == COMMENT)
+					break;
+				else if (!str && *s == '$')
+					ret = 2;
+			}
+		}
+		while (s < end && *s++ != '\n')
+			;
+	}
+	return (ret);
+}
@@ -34,11 +34,14 @@
 struct sym	 *symtab[HASHSIZE];	/* symbol table */
 struct sym	**symarray;		/* sorted symbol table */
 
+static struct opc *find_op(struct opc * const, const int,
+		    const char * const);
 static int 	hash(const char *);
 static int 	numcmp(const int, const int);
 
 /*
- *	binary search in sorted table opctab
+ *	search the opcode in the table of the Z80 and in the table of
+ *	the additions of the CPU of option -c
  *
  *	Input: pointer to string with opcode
  *
@@ -46,12 +49,54 @@ static int 	numcmp(const int, const int);
  */
 struct opc *
 search_op(const char * const op_name)
+{
+	struct opc	*op;
+
+	perf.pf_search++;
+	if (cpu_type == CPUZ80N &&
+	    (op = find_op(z80ntab, no_z80n, op_name)) != NULL)
+		return (op);
+	if ((op = find_op(opctab, no_opcodes, op_name)) != NULL) {
+		if (op->op_fun == op_sll && !undoc_flag)
+			return (NULL);		/* undocumented */
+		return (op);
+	}
+	if (cpu_type == CPUZ180)
+		return (find_op(z180tab, no_z180, op_name));
+	return (NULL);
+}
+
+/*
+ *	check if an opcode unknown to search_op() is an instruction
+ *	of another CPU, to report it as such
+ *
+ *	Input: pointer to string with opcode
+ *
+ *	Output: 1 if an opcode of another CPU, else 0
+ */
+int
+other_op(const char * const op_name)
+{
+	return (find_op(z180tab, no_z180, op_name) != NULL ||
+	    find_op(z80ntab, no_z80n, op_name) != NULL);
+}
+
+/*
+ *	binary search in sorted table of opcodes
+ *
+ *	Input: table and its no. of entries
+ *	       pointer to string with opcode
+ *
+ *	Output: pointer to table element, or NULL if not found
+ */
+static struct opc *
+find_op(struct opc * const tab, const int n, const char * const op_name)
 {
 	int		 cond;
 	struct opc	*low, *mid, *high;
 
-	low = &opctab[0];
-	high = &opctab[no_opcodes - 1];
+	low = &tab[0];
+	high = &tab[n - 1];
 	while (low <= high) {
 		mid = low + (high - low) / 2;
 		if ((cond = strcmp(op_name, mid->op_name)) < 0)
@@ -78,6 +123,7 @@ get_reg(const char * const s)
 	int		 cond;
 	struct ope	*low, *mid, *high;
 
+	perf.pf_getreg++;
 	if (s == NULL || *s == '\0')
 		return (NOOPERA);
 	low = &opetab[0];
@@ -88,6 +134,9 @@ get_reg(const char * const s)
 			high = mid - 1;
 		else if (cond > 0)
 			low = mid + 1;
+		else if (mid->ope_sym >= REGIXH &&
+		    mid->ope_sym <= REGIYL && !undoc_flag)
+			return (NOREG);		/* undocumented */
 		else
 			return (mid->ope_sym);
 	}
@@ -103,12 +152,30 @@ get_reg(const char * const s)
  */
 struct sym *
 get_sym(const char * const sym_name)
+{
+	perf.pf_getsym++;
+	return (find_sym(sym_name, &perf.pf_probes));
+}
+
+/*
+ *	hash search on symbol table symtab, for the worker threads
+ *	of the linker, which must not count into perf
+ *
+ *	Input: pointer to string with symbol
+ *	       counter of the symbols compared
+ *
+ *	Output: pointer to table element, or NULL if not found
+ */
+struct sym *
+find_sym(const char * const sym_name, unsigned long * const probes)
 {
 	struct sym	*np;
 
-	for (np = symtab[hash(sym_name)]; np != NULL; np = np->sym_next)
+	for (np = symtab[hash(sym_name)]; np != NULL; np = np->sym_next) {
+		(*probes)++;
 		if (strcmp(sym_name, np->sym_name) == 0)
 			return (np);
+	}
 	return (NULL);
 }
 
@@ -137,6 +204,9 @@ put_sym(const char * const sym_name, const int sym_val)
 			return (1);
 		hashval = hash(sym_name);
 		np->sym_next = symtab[hashval];
+		np->sym_line = c_line;
+		np->sym_sect = 0;
+		np->sym_ext = 0;
 		symtab[hashval] = np;
 	}
 	np->sym_val = sym_val;
@@ -149,13 +219,72 @@ put_sym(const char * const sym_name, const int sym_val)
 void
 put_label(void)
 {
+	struct sym	*np;
+
 	if (get_sym(label) == NULL) {
 		if (put_sym(label, pc))
 			fatal(F_OUTMEM, "symbols");
+		if ((np = get_sym(label)) != NULL)
+			np->sym_sect = cursect;
 	} else
 		asmerr(E_MULSYM);
 }
 
+/*
+ *	make symbol relative to the section and external symbol
+ *	of the last expression
+ */
+void
+set_rel(const char * const sym_name)
+{
+	struct sym	*np;
+
+	if ((np = get_sym(sym_name)) != NULL) {
+		np->sym_sect = ev_sect;
+		np->sym_ext = ev_ext;
+	}
+}
+
+/*
+ *	remove all symbols from symbol table symtab
+ */
+void
+clr_sym(void)
+{
+	int		 i;
+	struct sym	*np, *next;
+
+	for (i = 0; i < HASHSIZE; i++) {
+		for (np = symtab[i]; np != NULL; np = next) {
+			next = np->sym_next;
+			free(np->sym_name);
+			free(np);
+		}
+		symtab[i] = NULL;
+	}
+}
+
+/*
+ *	grow a table by SYMINC elements
+ *
+ *	Input: table, pointer to size of table, size of an element
+ *
+ *	Output: new table
+ */
+void *
+grow_tab(void *tab, size_t * const size, const size_t elem)
+{
+	size_t	newsize;
+
+	newsize = *size + SYMINC;
+	if (newsize > SIZE_MAX / elem)
+		fatal(F_INTERN, "overflow");
+	if ((tab = realloc(tab, newsize * elem)) == NULL)
+		fatal(F_OUTMEM, "tables");
+	*size = newsize;
+	return (tab);
+}
+
 /*
  *	hash algorithm
  *
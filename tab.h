@@ -31,6 +31,8 @@
 static struct opc opctab[] = {
 	{ "ADC",	op_adc,		0,	0	},
 	{ "ADD",	op_add,		0,	0	},
+	{ "ALIGN",	op_align,	0,	0	},
+	{ "ALIGNED",	op_aligned,	0,	0	},
 	{ "AND",	op_and,		0,	0	},
 	{ "BIT",	op_bit,		0,	0	},
 	{ "CALL",	op_call,	0,	0	},
@@ -41,6 +43,7 @@ static struct opc opctab[] = {
 	{ "CPI",	op_2b,		0xed,	0xa1	},
 	{ "CPIR",	op_2b,		0xed,	0xb1	},
 	{ "CPL",	op_1b,		0x2f,	0	},
+	{ "CYCLES",	op_cycles,	0,	0	},
 	{ "DAA",	op_1b,		0x27,	0	},
 	{ "DEC",	op_dec,		0,	0	},
 	{ "DEFB",	op_db,		0,	0	},
@@ -53,6 +56,7 @@ static struct opc opctab[] = {
 	{ "EI",		op_1b,		0xfb,	0	},
 	{ "EJECT",	op_misc,	1,	0	},
 	{ "ELSE",	op_cond,	98,	0	},
+	{ "ENDCROSS",	op_cross,	2,	0	},
 	{ "ENDIF",	op_cond,	99,	0	},
 	{ "EQU",	op_equ,		0,	0	},
 	{ "EX",		op_ex,		0,	0	},
@@ -80,8 +84,11 @@ static struct opc opctab[] = {
 	{ "LDIR",	op_2b,		0xed,	0xb0	},
 	{ "LIST",	op_misc,	2,	0	},
 	{ "NEG",	op_2b,		0xed,	0x44	},
+	{ "NOCROSS",	op_cross,	1,	0	},
 	{ "NOLIST",	op_misc,	3,	0	},
+	{ "NOOPT",	op_opt,		2,	0	},
 	{ "NOP",	op_1b,		0,	0	},
+	{ "OPT",	op_opt,		1,	0	},
 	{ "OR",		op_or,		0,	0	},
 	{ "ORG",	op_org,		0,	0	},
 	{ "OTDR",	op_2b,		0xed,	0xbb	},
@@ -111,19 +118,70 @@ static struct opc opctab[] = {
 	{ "RST",	op_rst,		0,	0	},
 	{ "SBC",	op_sbc,		0,	0	},
 	{ "SCF",	op_1b,		0x37,	0	},
+	{ "SECTION",	op_sect,	0,	0	},
 	{ "SET",	op_set,		0,	0	},
 	{ "SLA",	op_sla,		0,	0	},
+	{ "SLL",	op_sll,		0,	0	},
 	{ "SRA",	op_sra,		0,	0	},
 	{ "SRL",	op_srl,		0,	0	},
 	{ "SUB",	op_sub,		0,	0	},
 	{ "TITLE",	op_misc,	7,	0	},
+	{ "UEXPECT",	op_test,	3,	0	},
+	{ "USET",	op_test,	2,	0	},
+	{ "UTEST",	op_test,	1,	0	},
 	{ "XOR",	op_xor,		0,	0	}
 };
 
+/*
+ *	opcode table of the Z180/HD64180 additions, searched with -c z180
+ *	must be sorted in ascending order!
+ */
+static struct opc z180tab[] = {
+	{ "IN0",	op_in0,		0,	0	},
+	{ "MLT",	op_mlt,		0,	0	},
+	{ "OTDM",	op_2b,		0xed,	0x8b	},
+	{ "OTDMR",	op_2b,		0xed,	0x9b	},
+	{ "OTIM",	op_2b,		0xed,	0x83	},
+	{ "OTIMR",	op_2b,		0xed,	0x93	},
+	{ "OUT0",	op_out0,	0,	0	},
+	{ "SLP",	op_2b,		0xed,	0x76	},
+	{ "TST",	op_tst,		0,	0	},
+	{ "TSTIO",	op_tstio,	0,	0	}
+};
+
+/*
+ *	opcode table of the Z80N additions, searched with -c z80n
+ *	must be sorted in ascending order!
+ */
+static struct opc z80ntab[] = {
+	{ "BRLC",	op_2b,		0xed,	0x2c	},
+	{ "BSLA",	op_2b,		0xed,	0x28	},
+	{ "BSRA",	op_2b,		0xed,	0x29	},
+	{ "BSRF",	op_2b,		0xed,	0x2b	},
+	{ "BSRL",	op_2b,		0xed,	0x2a	},
+	{ "LDDRX",	op_2b,		0xed,	0xbc	},
+	{ "LDDX",	op_2b,		0xed,	0xac	},
+	{ "LDIRX",	op_2b,		0xed,	0xb4	},
+	{ "LDIX",	op_2b,		0xed,	0xa4	},
+	{ "LDPIRX",	op_2b,		0xed,	0xb7	},
+	{ "LDWS",	op_2b,		0xed,	0xa5	},
+	{ "MIRROR",	op_2b,		0xed,	0x24	},
+	{ "MUL",	op_2b,		0xed,	0x30	},
+	{ "NEXTREG",	op_nreg,	0,	0	},
+	{ "OUTINB",	op_2b,		0xed,	0x90	},
+	{ "PIXELAD",	op_2b,		0xed,	0x94	},
+	{ "PIXELDN",	op_2b,		0xed,	0x93	},
+	{ "SETAE",	op_2b,		0xed,	0x95	},
+	{ "SWAPNIB",	op_2b,		0xed,	0x23	},
+	{ "TEST",	op_ntest,	0,	0	}
+};
+
 /*
  *	compute no. of table entries for search_op()
  */
 static int	no_opcodes = sizeof(opctab) / sizeof(struct opc);
+static int	no_z180 = sizeof(z180tab) / sizeof(struct opc);
+static int	no_z80n = sizeof(z80ntab) / sizeof(struct opc);
 
 /*
  *	table with reserved operand words: registers and flags
@@ -148,7 +206,11 @@ static struct ope opetab[] = {
 	{ "HL",		REGHL  },
 	{ "I",		REGI   },
 	{ "IX",		REGIX  },
+	{ "IXH",	REGIXH },
+	{ "IXL",	REGIXL },
 	{ "IY",		REGIY  },
+	{ "IYH",	REGIYH },
+	{ "IYL",	REGIYL },
 	{ "L",		REGL   },
 	{ "M",		FLGM   },
 	{ "NC",		FLGNC  },
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 1987-2014 Udo Munk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ *	module for the tests of -u
+ *	UTEST, USET and UEXPECT are collected in pass 2, after pass 2 every
+ *	test runs on its own copy of the memory image in the Z80
+ *	interpreter of emu.c, as many in parallel as there are CPU's;
+ *	a test begins with its entry point called and ends, when it
+ *	returns, or at HALT
+ */
+
+#include <err.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zz80asm.h"
+
+#define MEMSIZE	65536		/* size of Z80 address space */
+#define TESTMAX	10000000UL	/* default max. T-states of a test */
+#define TESTRET	0x0000		/* return address of a test */
+
+/*
+ *	structure register or memory values set before and expected
+ *	after a test
+ */
+struct tval {
+	char	*tv_file;	/* filename */
+	size_t	 tv_line;	/* line no. */
+	int	 tv_expect;	/* expected after, or set before the test */
+	int	 tv_reg;	/* index in regs[], -1 for memory */
+	int	 tv_adr;	/* address of memory */
+	long	 tv_val;	/* value */
+	long	 tv_got;	/* value after the test */
+};
+
+/*
+ *	structure tests
+ */
+struct test {
+	char		*te_file;	/* filename */
+	size_t		 te_line;	/* line no. */
+	int		 te_entry;	/* entry point */
+	unsigned long	 te_max;	/* max. T-states */
+	unsigned long	 te_cycles;	/* T-states used */
+	int		 te_end;	/* 0 returned, 1 HALT, 2 timed out */
+	struct tval	*te_vals;	/* values set and expected */
+	size_t		 te_nvals, te_svals;	/* no. and size of te_vals */
+};
+
+static void	*test_worker(void *);
+static void	 test_one(struct test * const);
+static long	 get_val(const struct cpu * const, const struct tval * const,
+		    const unsigned long);
+static void	 set_val(struct cpu * const, const struct tval * const);
+
+static const char *regs[] = {	/* registers in USET and UEXPECT */
+	"A", "F", "B", "C", "D", "E", "H", "L", "I", "R",
+	"AF", "BC", "DE", "HL", "IX", "IY", "SP", "T", NULL
+};
+#define T_AF	10		/* first 16 bit register in regs[] */
+#define T_T	17		/* T-states in regs[] */
+
+static struct test	*tests;		/* tests in source order */
+static size_t		 ntests, stests;	/* no. and size of tests */
+static size_t		 nexttest;	/* next test to run */
+static const unsigned char *image;	/* memory image */
+static pthread_mutex_t	 test_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ *	index of a register for USET and UEXPECT
+ *
+ *	Output: index, or -1 if none
+ */
+int
+test_reg(const char * const s)
+{
+	int	i;
+
+	for (i = 0; regs[i] != NULL; i++)
+		if (strcmp(regs[i], s) == 0)
+			return (i);
+	return (-1);
+}
+
+/*
+ *	UTEST: begin a new test
+ */
+void
+test_begin(const int entry, const unsigned long max)
+{
+	struct test	*tp;
+
+	if (ntests == stests)
+		tests = grow_tab(tests, &stests, sizeof(struct test));
+	tp = &tests[ntests++];
+	memset(tp, 0, sizeof(struct test));
+	if ((tp->te_file = strdup(srcfn)) == NULL)
+		fatal(F_OUTMEM, "tests");
+	tp->te_line = c_line;
+	tp->te_entry = entry & 0xffff;
+	tp->te_max = max ? max : TESTMAX;
+}
+
+/*
+ *	USET and UEXPECT: add a value to the last test
+ *
+ *	Input: value is expected, register or -1, address, value
+ *
+ *	Output: 0 if there is no test
+ */
+int
+test_value(const int expect, const int reg, const int adr, const long val)
+{
+	struct test	*tp;
+	struct tval	*vp;
+
+	if (ntests == 0)
+		return (0);
+	tp = &tests[ntests - 1];
+	if (tp->te_nvals == tp->te_svals)
+		tp->te_vals = grow_tab(tp->te_vals, &tp->te_svals,
+		    sizeof(struct tval));
+	vp = &tp->te_vals[tp->te_nvals++];
+	if ((vp->tv_file = strdup(srcfn)) == NULL)
+		fatal(F_OUTMEM, "tests");
+	vp->tv_line = c_line;
+	vp->tv_expect = expect;
+	vp->tv_reg = reg;
+	vp->tv_adr = adr & 0xffff;
+	if (reg == T_T)
+		vp->tv_val = val;
+	else if (reg >= T_AF)
+		vp->tv_val = val & 0xffff;
+	else
+		vp->tv_val = val & 0xff;
+	return (1);
+}
+
+/*
+ *	run all tests on the memory image and report the failed ones
+ */
+void
+test_run(const unsigned char * const mem)
+{
+	long		 i, n;
+	size_t		 j, k;
+	int		 failed;
+	char		 arg[64];
+	pthread_t	*tids;
+	struct test	*tp;
+	struct tval	*vp;
+
+	if (ntests == 0)
+		return;
+	emu_init();
+	image = mem;
+	nexttest = 0;
+	if ((n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		n = 1;
+	if ((size_t)n > ntests)
+		n = (long)ntests;
+	if (n <= 1)
+		test_worker(NULL);
+	else {
+		if ((tids = calloc((size_t)n, sizeof(pthread_t))) == NULL)
+			fatal(F_OUTMEM, "threads");
+		for (i = 0; i < n; i++)
+			if (pthread_create(&tids[i], NULL, test_worker,
+			    NULL) != 0)
+				errx(1, "can't create thread");
+		for (i = 0; i < n; i++)
+			pthread_join(tids[i], NULL);
+		free(tids);
+	}
+	for (failed = 0, j = 0; j < ntests; j++) {
+		tp = &tests[j];
+		k = (size_t)errors;
+		if (tp->te_end == 2) {
+			snprintf(arg, sizeof(arg), "no return after %lu "
+			    "T-states", tp->te_cycles);
+			asmerr_at(E_TEST, tp->te_file, tp->te_line, arg);
+		}
+		for (vp = tp->te_vals; vp < tp->te_vals + tp->te_nvals; vp++) {
+			if (!vp->tv_expect || vp->tv_got == vp->tv_val)
+				continue;
+			if (vp->tv_reg == T_T)
+				snprintf(arg, sizeof(arg), "T is %ld, expected "
+				    "%ld", vp->tv_got, vp->tv_val);
+			else if (vp->tv_reg < 0)
+				snprintf(arg, sizeof(arg), "(%04X) is %02lX, "
+				    "expected %02lX", vp->tv_adr, vp->tv_got,
+				    vp->tv_val);
+			else
+				snprintf(arg, sizeof(arg), "%s is %0*lX, "
+				    "expected %0*lX", regs[vp->tv_reg],
+				    (vp->tv_reg >= T_AF) ? 4 : 2, vp->tv_got,
+				    (vp->tv_reg >= T_AF) ? 4 : 2, vp->tv_val);
+			asmerr_at(E_TEST, vp->tv_file, vp->tv_line, arg);
+		}
+		if ((size_t)errors != k)
+			failed++;
+	}
+	if (ver_flag)
+		fprintf(stdout, "   Test    %zu test(s), %d failed\n", ntests,
+		    failed);
+}
+
+/*
+ *	worker thread: take the next test until all are done
+ */
+static void *
+test_worker(void *arg)
+{
+	size_t	i;
+
+	(void)arg;
+	for (;;) {
+		pthread_mutex_lock(&test_mtx);
+		i = nexttest++;
+		pthread_mutex_unlock(&test_mtx);
+		if (i >= ntests)
+			break;
+		test_one(&tests[i]);
+	}
+	return (NULL);
+}
+
+/*
+ *	run one test
+ */
+static void
+test_one(struct test * const tp)
+{
+	struct cpu	 cpu;
+	struct tval	*vp;
+	unsigned long	 t;
+	int		 sp;
+
+	memset(&cpu, 0, sizeof(cpu));
+	if ((cpu.cp_mem = malloc(MEMSIZE)) == NULL)
+		fatal(F_OUTMEM, "tests");
+	memcpy(cpu.cp_mem, image, MEMSIZE);
+	for (vp = tp->te_vals; vp < tp->te_vals + tp->te_nvals; vp++)
+		if (!vp->tv_expect)
+			set_val(&cpu, vp);
+	sp = cpu.cp_sp;
+	cpu.cp_sp = (sp - 2) & 0xffff;		/* CALL of the entry */
+	cpu.cp_mem[cpu.cp_sp] = TESTRET & 0xff;
+	cpu.cp_mem[(cpu.cp_sp + 1) & 0xffff] = TESTRET >> 8;
+	cpu.cp_pc = tp->te_entry;
+	tp->te_end = 2;
+	for (t = 0; t <= tp->te_max; t += (unsigned long)emu_step(&cpu)) {
+		if (cpu.cp_pc == TESTRET && cpu.cp_sp == sp) {
+			tp->te_end = 0;
+			break;
+		}
+		if (cpu.cp_halt) {
+			tp->te_end = 1;
+			break;
+		}
+	}
+	tp->te_cycles = t;
+	for (vp = tp->te_vals; vp < tp->te_vals + tp->te_nvals; vp++)
+		if (vp->tv_expect)
+			vp->tv_got = get_val(&cpu, vp, t);
+	free(cpu.cp_mem);
+}
+
+/*
+ *	value of a register or memory after a test
+ */
+static long
+get_val(const struct cpu * const cp, const struct tval * const vp,
+    const unsigned long t)
+{
+	switch (vp->tv_reg) {
+	case -1:
+		return (cp->cp_mem[vp->tv_adr]);
+	case 0:					/* A */
+		return (cp->cp_reg[7]);
+	case 1:					/* F */
+		return (cp->cp_reg[6]);
+	case 8:					/* I */
+		return (cp->cp_i);
+	case 9:					/* R */
+		return (cp->cp_r);
+	case T_AF:
+		return ((cp->cp_reg[7] << 8) | cp->cp_reg[6]);
+	case 11:				/* BC */
+	case 12:				/* DE */
+	case 13:				/* HL */
+		return ((cp->cp_reg[(vp->tv_reg - 11) * 2] << 8) |
+		    cp->cp_reg[(vp->tv_reg - 11) * 2 + 1]);
+	case 14:				/* IX */
+		return (cp->cp_ix);
+	case 15:				/* IY */
+		return (cp->cp_iy);
+	case 16:				/* SP */
+		return (cp->cp_sp);
+	case T_T:
+		return ((long)t);
+	default:				/* B, C, D, E, H, L */
+		return (cp->cp_reg[vp->tv_reg - 2]);
+	}
+}
+
+/*
+ *	set a register or memory before a test
+ */
+static void
+set_val(struct cpu * const cp, const struct tval * const vp)
+{
+	int	v;
+
+	v = (int)vp->tv_val;
+	switch (vp->tv_reg) {
+	case -1:
+		cp->cp_mem[vp->tv_adr] = v & 0xff;
+		break;
+	case 0:					/* A */
+		cp->cp_reg[7] = v & 0xff;
+		break;
+	case 1:					/* F */
+		cp->cp_reg[6] = v & 0xff;
+		break;
+	case 8:					/* I */
+		cp->cp_i = v & 0xff;
+		break;
+	case 9:					/* R */
+		cp->cp_r = v & 0xff;
+		break;
+	case T_AF:
+		cp->cp_reg[7] = (v >> 8) & 0xff;
+		cp->cp_reg[6] = v & 0xff;
+		break;
+	case 11:				/* BC */
+	case 12:				/* DE */
+	case 13:				/* HL */
+		cp->cp_reg[(vp->tv_reg - 11) * 2] = (v >> 8) & 0xff;
+		cp->cp_reg[(vp->tv_reg - 11) * 2 + 1] = v & 0xff;
+		break;
+	case 14:				/* IX */
+		cp->cp_ix = v & 0xffff;
+		break;
+	case 15:				/* IY */
+		cp->cp_iy = v & 0xffff;
+		break;
+	case 16:				/* SP */
+		cp->cp_sp = v & 0xffff;
+		break;
+	case T_T:
+		break;
+	default:				/* B, C, D, E, H, L */
+		cp->cp_reg[vp->tv_reg - 2] = v & 0xff;
+	}
+}
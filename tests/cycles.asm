@@ -0,0 +1,6 @@
+; the label of CYCLES is defined and can end the budget
+; expect: 00 00 04 00
+	NOP
+	NOP
+	DEFW	E
+E:	CYCLES	0,E,8
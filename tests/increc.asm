@@ -0,0 +1,4 @@
+; a file including itself under another name is a recursive INCLUDE
+; expect: error
+	NOP
+	INCLUDE	./tests/increc.asm
@@ -0,0 +1,9 @@
+; labels of the pseudo-ops without code are defined
+; expect: 00 00 00 03 00 03 00
+A:	NOCROSS
+	NOP
+	NOP
+	NOP
+B:	ENDCROSS
+C:	ALIGNED	1
+	DEFW	B,C
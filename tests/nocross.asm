@@ -0,0 +1,5 @@
+; a NOCROSS region must be closed with ENDCROSS
+; expect: error
+	NOP
+	NOCROSS
+	NOP
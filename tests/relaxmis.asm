@@ -0,0 +1,5 @@
+; a conditional JP or JR without target is an error with -j
+; args: -j
+; expect: error
+	JP	Z
+	JR	NZ
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# regression tests of zz80asm
+# every tests/*.asm is assembled into a binary, its comments give the
+# options and the expected result:
+#	; args: options of zz80asm
+#	; expect: bytes of the binary in hex, or error if it must fail
+#
+# usage: run.sh zz80asm
+
+[ $# -eq 1 ] || { echo "usage: run.sh zz80asm" >&2; exit 1; }
+asm=$1
+dir=$(dirname "$0")
+tmp=${TMPDIR:-/tmp}/zz80test.$$
+trap 'rm -f $tmp.bin $tmp.out' EXIT
+
+fail=0
+for src in "$dir"/*.asm; do
+	args=$(sed -n 's/^; args: *//p' "$src")
+	expect=$(sed -n 's/^; expect: *//p' "$src")
+	rm -f $tmp.bin
+	if $asm $args -f b -o $tmp.bin "$src" > $tmp.out 2>&1; then
+		got=$(od -An -tx1 -v $tmp.bin | tr -s ' \n' '  ' |
+		    sed 's/^ //; s/ $//')
+	else
+		got=error
+	fi
+	if [ "$got" != "$expect" ]; then
+		echo "FAIL $src: expected $expect, got $got" >&2
+		cat $tmp.out >&2
+		fail=1
+	else
+		echo "ok   $src"
+	fi
+done
+exit $fail
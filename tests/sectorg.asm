@@ -0,0 +1,12 @@
+; a section with its own ORG below CODE does not move the sections
+; placed after it back
+; expect: aa bb ff ff 3e 01 00 01
+	ORG	4
+	LD	A,1
+	SECTION	DATA
+	ORG	0
+D:	DEFB	0AAH,0BBH
+	SECTION	X
+	DEFB	1
+	SECTION	CODE
+	NOP
@@ -0,0 +1,9 @@
+; a section with its own ORG must not overlap CODE
+; expect: error
+	LD	A,1
+	LD	B,2
+	SECTION	DATA
+	ORG	1
+D:	DEFB	0AAH,0BBH
+	SECTION	CODE
+	NOP
@@ -0,0 +1,10 @@
+; the unit tests run with -c z80n, whose TEST n is an instruction
+; args: -u -c z80n
+; expect: ed 30 ed 27 0f c9
+	UTEST	MULT
+	USET	DE,0607H
+	UEXPECT	DE,42
+	UEXPECT	F,54H
+MULT:	MUL	D,E
+	TEST	0FH
+	RET
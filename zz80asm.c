@@ -24,9 +24,13 @@
  *	main module, handles the options and runs 2 passes over the sources
  */
 
+#include <sys/types.h>
+#include <sys/wait.h>
+
 #include <ctype.h>
 #include <err.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,11 +45,21 @@ static void 	 pass1(void);
 static void 	 pass2(void);
 static int 	 p1_line(void);
 static int 	 p2_line(void);
-static void 	 open_o_files(const char * const);
-static void 	 get_fn(char * const, char * const, const char * const);
+static void 	 get_o_names(const char * const);
+static const char *obj_ext(void);
+static void 	 open_o_files(void);
+static void 	 get_fn(char * const, const size_t, char * const,
+		    const char * const);
 static char	*get_label(char *, char *);
 static char	*get_opcode(char *, char *);
 static char	*get_arg(char *, char *);
+static int	 assemble(const char * const);
+static int	 run_variants(void);
+static void	 add_def(char ** const, const char * const);
+static void	 add_variant(const char * const);
+static void	 add_root(const char * const);
+static void	 def_syms(const char *);
+static void	 add_suffix(char * const, const size_t, const char * const);
 
 FILE		*srcfp;		/* file pointer for current source */
 FILE		*objfp;		/* file pointer for object code */
@@ -60,7 +74,16 @@ char		 operand[LINE_MAX];	/* buffer for operand */
 uint8_t		 list_flag;	/* flag for option -l */
 uint8_t		 ver_flag;	/* flag for option -v */
 uint8_t		 dump_flag;	/* flag for option -x */
+uint8_t		 pack_flag;	/* flag for option -p */
+uint8_t		 cyc_flag;	/* flag for option -t */
+uint8_t		 relax_flag;	/* flag for option -j */
+uint8_t		 opt_flag;	/* flag for option -O */
+uint8_t		 lint_flag;	/* flag for option -W */
+uint8_t		 test_flag;	/* flag for option -u */
+uint8_t		 prof_flag;	/* flag for option -P */
+uint8_t		 undoc_flag;	/* flag for option -U */
 int		 pc;		/* program counter */
+int		 cursect;	/* current section, 0 if absolute */
 uint8_t		 pass;		/* processed pass */
 int		 iflevel;	/* IF nesting level */
 int		 gencode;	/* flag for conditional object code */
@@ -72,6 +95,7 @@ uint8_t		 sd_flag;	/* list flag for PSEUDO opcodes */
 				/* = 3: addr from <sd_val>, no data */
 				/* = 4: suppress whole line */
 uint8_t		 out_form;	/* format of object file */
+uint8_t		 cpu_type;	/* instruction set of option -c */
 
 size_t		 c_line;	/* current line no. in current source */
 size_t		 s_line;	/* line no. counter for listing */
@@ -84,18 +108,34 @@ static char	*errmsg[] = {	/* error messages for fatal() */
 	"internal error: %s"	/* 3 */
 };
 
-static char	*infiles[MAXFN];	/* source filenames */
+static char	**infiles;		/* source filenames */
 static char	 objfn[PATH_MAX];	/* object filename */
 static char	 lstfn[PATH_MAX];	/* listing filename */
 static char	 opcode[LINE_MAX];	/* buffer for opcode */
+static char	 depfn[PATH_MAX];	/* dependency filename */
+static char	 tracefn[PATH_MAX];	/* trace filename */
+
+static int	 sym_flag;		/* flag for option -s */
+static int	 perf_flag;		/* format of option -T */
+static int	 pch_flag;		/* flag for option -H */
+static int	 link_flag;		/* flag for option -L */
+static int	 link_org;		/* origin for option -L */
+static char	**roots;		/* symbols of options -e and -k */
+static size_t	 nroots;		/* no. of roots */
+static char	*cache_dir;		/* directory for option -C */
+static char	*dep_flag;		/* filename for option -d */
+static char	*trace_flag;		/* filename for option -g */
+static size_t	 cache_max = CACHEMAX;	/* size for option -M */
+static char	*defs;			/* symbols of option -D */
+static char	**variants;		/* variants of option -V */
+static size_t	 nvariants;		/* no. of variants */
 
 int
 main(int argc, char *argv[])
 {
-	int	i, ch;
-	size_t	len;
-
-	int	sym_flag = 0;	/* flag for option -s */
+	int		 i, ch, ret;
+	size_t		 len;
+	char		**fp, *ep;
 
 	/* program defaults */
 	gencode = 1;
@@ -107,7 +147,8 @@ main(int argc, char *argv[])
 	datalen = 16;		/* default num of bytes/hex record */
 
 
-	while ((ch = getopt(argc, argv, "b:f:l::o:s:vx")) != -1) {
+	while ((ch = getopt(argc, argv,
+	    "b:C:c:D:d:e:f:g:Hjk:L:l::M:Oo:P:ps:T:tUuV:vWx")) != -1) {
 		switch (ch) {
 		case 'b':
 			errno = 0;
@@ -117,6 +158,48 @@ main(int argc, char *argv[])
 				/* NOTREACHED */
 			}
 			break;
+		case 'C':
+			cache_dir = optarg;
+			break;
+		case 'D':
+			add_def(&defs, optarg);
+			break;
+		case 'd':
+			dep_flag = optarg;
+			break;
+		case 'j':
+			relax_flag = 1;
+			break;
+		case 'O':
+			opt_flag = 1;
+			break;
+		case 'W':
+			lint_flag = 1;
+			break;
+		case 'u':
+			test_flag = 1;
+			break;
+		case 'P':
+			prof_flag = 1;
+			prof_load(optarg);
+			break;
+		case 'U':
+			undoc_flag = 1;
+			break;
+		case 'c':
+			if (strcmp(optarg, "z80") == 0)
+				cpu_type = CPUZ80;
+			else if (strcmp(optarg, "z180") == 0)
+				cpu_type = CPUZ180;
+			else if (strcmp(optarg, "z80n") == 0)
+				cpu_type = CPUZ80N;
+			else
+				usage();
+			break;
+		case 'e':
+		case 'k':
+			add_root(optarg);
+			break;
 		case 'f':
 			switch (*optarg) {
 			case 'b':
@@ -128,25 +211,52 @@ main(int argc, char *argv[])
 			case 'h':
 				out_form = OUTHEX;
 				break;
+			case 'r':
+				out_form = OUTREL;
+				break;
 			default:
 				usage();
 				/* NOTREACHED */
 			}
 			break;
+		case 'g':
+			trace_flag = optarg;
+			break;
+		case 'H':
+			pch_flag = 1;
+			break;
+		case 'L':
+			errno = 0;
+			link_org = (int)strtol(optarg, &ep, 0);
+			if (*ep != '\0' || link_org < 0 || link_org > 0xffff ||
+			    errno != 0) {
+				errx(1, "%s: bad origin", optarg);
+				/* NOTREACHED */
+			}
+			link_flag = 1;
+			break;
 		case 'l':
 			if (optarg != '\0')
-				get_fn(lstfn, optarg, LSTEXT);
+				get_fn(lstfn, sizeof(lstfn), optarg, LSTEXT);
 			list_flag = 1;
 			break;
+		case 'M':
+			errno = 0;
+			cache_max = strtoul(optarg, NULL, 0);
+			if ((cache_max == 0) || (errno != 0)) {
+				errx(1, "%s: bad cache size", optarg);
+				/* NOTREACHED */
+			}
+			break;
 		case 'o':
 			if (optarg == '\0') {
 				usage();
 				/* NOTREACHED */
 			}
-			if (out_form == OUTHEX)
-				get_fn(objfn, optarg, OBJEXTHEX);
-			else
-				get_fn(objfn, optarg, OBJEXTBIN);
+			get_fn(objfn, sizeof(objfn), optarg, obj_ext());
+			break;
+		case 'p':
+			pack_flag = 1;
 			break;
 		case 's':
 			switch (*optarg) {
@@ -161,6 +271,19 @@ main(int argc, char *argv[])
 				/* NOTREACHED */
 			}
 			break;
+		case 't':
+			cyc_flag = 1;
+			break;
+		case 'T':
+			if (*optarg != 't' && *optarg != 'j') {
+				usage();
+				/* NOTREACHED */
+			}
+			perf_flag = *optarg;
+			break;
+		case 'V':
+			add_variant(optarg);
+			break;
 		case 'v':
 			ver_flag = 1;
 			break;
@@ -180,35 +303,316 @@ main(int argc, char *argv[])
 		usage();
 		/* NOTREACHED */
 	}
-	for (i = 0; (argc--) && (i < MAXFN); i++) {
-		if ((infiles[i] = malloc(PATH_MAX)) == NULL) {
-			while (--i >= 0)
-				free(infiles[i]);
+	/* The Z180 traps on the undocumented instructions. */
+	if (undoc_flag && cpu_type == CPUZ180) {
+		usage();
+		/* NOTREACHED */
+	}
+	if ((infiles = calloc((size_t)argc + 1, sizeof(char *))) == NULL)
+		fatal(F_OUTMEM, "filenames");
+	for (i = 0; argc--; i++) {
+		len = strlen(*argv) + sizeof(SRCEXT);
+		if ((infiles[i] = malloc(len)) == NULL)
 			fatal(F_OUTMEM, "filenames");
-		}
-		get_fn(infiles[i], *argv++, SRCEXT);
+		get_fn(infiles[i], len, *argv++, SRCEXT);
 	}
 	if (i == 0) {
+		if (cache_dir != NULL) {	/* report on build cache */
+			cache_stats(cache_dir, cache_max);
+			return (0);
+		}
 		fprintf(errfp, "%s\n", "no input file");
 		usage();
 		/* NOTREACHED */
 	}
 	if (ver_flag)
 		fprintf(stdout, "%s Release %s, %s\n", __progname, REL, COPYR);
+	if (link_flag) {
+		if (out_form == OUTREL)
+			usage();
+		get_o_names(infiles[0]);
+		ret = link_files(infiles, link_org, objfn,
+		    list_flag ? lstfn : NULL, roots);
+		if (perf_flag)
+			perf_print(perf_flag, objfn, NULL);
+	} else if (pch_flag)
+		for (ret = 0, fp = infiles; *fp != NULL; fp++)
+			ret += pch_write(*fp);
+	else if (nvariants)
+		ret = run_variants();
+	else
+		ret = assemble(NULL);
+	while (i > 0)
+		free(infiles[--i]);
+	free(infiles);
+	return (ret);
+}
+
+/*
+ *	assemble all source files
+ *
+ *	Input: variant "name:definitions", or NULL
+ *
+ *	Output: no. of errors
+ */
+static int
+assemble(const char * const var)
+{
+	size_t		 len;
+	char		*p;
+	uint64_t	 key = 0;	/* key of run in build cache */
+	int		 cache;		/* use the build cache */
+
+	get_o_names(infiles[0]);
+	if (dep_flag != NULL)
+		strlcpy(depfn, dep_flag, sizeof(depfn));
+	if (trace_flag != NULL)
+		strlcpy(tracefn, trace_flag, sizeof(tracefn));
+	if (var != NULL) {		/* variant: name the output after it */
+		if ((p = strdup(var)) == NULL)
+			fatal(F_OUTMEM, "variants");
+		if (strchr(p, ':') != NULL) {
+			add_def(&defs, strchr(p, ':') + 1);
+			*strchr(p, ':') = '\0';
+		}
+		add_suffix(objfn, sizeof(objfn), p);
+		if (list_flag)
+			add_suffix(lstfn, sizeof(lstfn), p);
+		if (dep_flag != NULL)
+			add_suffix(depfn, sizeof(depfn), p);
+		if (trace_flag != NULL)
+			add_suffix(tracefn, sizeof(tracefn), p);
+		free(p);
+	}
+	if (defs != NULL)
+		def_syms(defs);
+	/* the diagnostics of -W, -u and -P are not cached */
+	cache = cache_dir != NULL && !lint_flag && !test_flag && !prof_flag;
+	if (cache) {
+		key = cache_key(infiles, sym_flag, defs);
+		if (cache_get(cache_dir, key, objfn, lstfn)) {
+			if (ver_flag)
+				fprintf(stdout, "Cache hit %016" PRIx64 "\n",
+				    key);
+			if (dep_flag != NULL)
+				dep_write(depfn, objfn,
+				    list_flag ? lstfn : NULL);
+			return (0);
+		}
+		if (ver_flag)
+			fprintf(stdout, "Cache miss %016" PRIx64 "\n", key);
+	}
+	if (trace_flag != NULL)
+		perf_trace(tracefn, objfn);
 	pass1();
 	pass2();
-	while (i > 0)
-		free(infiles[i--]);
 	if (list_flag && sym_flag) {
+		perf_start(PF_SORT);
 		len = copy_sym();
 		sort_sym(len, sym_flag);
+		perf_stop(PF_SORT);
+		perf_start(PF_LIST);
 		lst_sort_sym(len);
+		perf_stop(PF_LIST);
 	}
-	if (lstfp)
+	if (lstfp) {
+		perf_start(PF_LIST);
 		fclose(lstfp);
+		perf_stop(PF_LIST);
+	}
+	if (dep_flag != NULL && errors == 0)
+		dep_write(depfn, objfn, list_flag ? lstfn : NULL);
+	if (cache && errors == 0)
+		cache_put(cache_dir, key, objfn, lstfn, cache_max);
+	if (perf_flag)
+		perf_print(perf_flag, objfn, list_flag ? lstfn : NULL);
+	perf_close();
 	return (errors);
 }
 
+/*
+ *	assemble every variant in a process of its own, as many
+ *	in parallel as there are CPU's; the sources are read before
+ *	forking, so all processes share the source cache
+ *
+ *	Output: no. of errors of all variants
+ */
+static int
+run_variants(void)
+{
+	size_t	i;
+	long	ncpu, running;
+	int	status, errs;
+	pid_t	pid;
+	char	**fp;
+
+	for (fp = infiles; *fp != NULL; fp++)
+		src_hash(*fp);
+	if ((ncpu = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		ncpu = 1;
+	errs = 0;
+	running = 0;
+	for (i = 0; i < nvariants || running > 0;) {
+		if (i < nvariants && running < ncpu) {
+			fflush(stdout);
+			switch (pid = fork()) {
+			case -1:
+				err(1, "fork");
+				/* NOTREACHED */
+			case 0:
+				if (ver_flag)
+					fprintf(stdout, "Variant %s\n",
+					    variants[i]);
+				exit(assemble(variants[i]));
+				/* NOTREACHED */
+			default:
+				running++;
+				i++;
+				continue;
+			}
+		}
+		if (wait(&status) == -1)
+			err(1, "wait");
+		running--;
+		if (!WIFEXITED(status))
+			errs++;
+		else
+			errs += WEXITSTATUS(status);
+	}
+	return (errs);
+}
+
+/*
+ *	append comma separated symbol definitions "s" to list "*l"
+ */
+static void
+add_def(char ** const l, const char * const s)
+{
+	char	*p;
+	size_t	 len;
+
+	len = strlen(s) + 1;
+	if (*l != NULL)
+		len += strlen(*l) + 1;
+	if ((p = malloc(len)) == NULL)
+		fatal(F_OUTMEM, "symbol definitions");
+	if (*l != NULL) {
+		strlcpy(p, *l, len);
+		strlcat(p, ",", len);
+		strlcat(p, s, len);
+		free(*l);
+	} else
+		strlcpy(p, s, len);
+	*l = p;
+}
+
+/*
+ *	add a variant "name:definitions" for option -V,
+ *	or read variants from file if the argument is @file
+ */
+static void
+add_variant(const char * const arg)
+{
+	FILE	*fp;
+	char	 buf[LINE_MAX], *p;
+	char	**newv;
+
+	if (*arg == '@') {
+		if ((fp = fopen(arg + 1, "r")) == NULL)
+			fatal(F_FOPEN, arg + 1);
+		while (fgets(buf, sizeof(buf), fp) != NULL) {
+			buf[strcspn(buf, "\r\n")] = '\0';
+			for (p = buf; isspace((int)*p); p++)
+				;
+			if (*p != '\0' && *p != COMMENT && *p != '#')
+				add_variant(p);
+		}
+		fclose(fp);
+		return;
+	}
+	if (*arg == '\0' || *arg == ':')
+		errx(1, "%s: missing variant name", arg);
+	newv = realloc(variants, (nvariants + 1) * sizeof(char *));
+	if (newv == NULL)
+		fatal(F_OUTMEM, "variants");
+	variants = newv;
+	if ((variants[nvariants++] = strdup(arg)) == NULL)
+		fatal(F_OUTMEM, "variants");
+}
+
+/*
+ *	add a symbol for options -e and -k, the linker keeps
+ *	everything reachable from it
+ */
+static void
+add_root(const char * const s)
+{
+	char	**newr, *p;
+
+	newr = realloc(roots, (nroots + 2) * sizeof(char *));
+	if (newr == NULL)
+		fatal(F_OUTMEM, "symbols");
+	roots = newr;
+	if ((p = strdup(s)) == NULL)
+		fatal(F_OUTMEM, "symbols");
+	if (strlen(p) > SYMSIZE)
+		p[SYMSIZE] = '\0';
+	roots[nroots++] = p;
+	roots[nroots] = NULL;
+	for (; *p; p++)
+		*p = (char)toupper((unsigned char)*p);
+}
+
+/*
+ *	define symbols from a comma separated list of NAME[=value],
+ *	the value defaults to 1
+ */
+static void
+def_syms(const char *s)
+{
+	char	 name[SYMSIZE + 1], *ep;
+	int	 i;
+	long	 val;
+
+	while (*s) {
+		for (i = 0; *s && *s != ',' && *s != '='; s++)
+			if (i < SYMSIZE)
+				name[i++] = islower((int)*s) ?
+				    (char)toupper((int)*s) : *s;
+		name[i] = '\0';
+		val = 1;
+		if (*s == '=') {
+			errno = 0;
+			val = strtol(++s, &ep, 0);
+			if (ep == s || (*ep && *ep != ',') || errno != 0)
+				errx(1, "%s: bad value for %s", s, name);
+			s = ep;
+		}
+		if (*name && put_sym(name, (int)val))
+			fatal(F_OUTMEM, "symbols");
+		if (*s == ',')
+			s++;
+	}
+}
+
+/*
+ *	insert "-name" in front of the extension of filename "fn"
+ */
+static void
+add_suffix(char * const fn, const size_t size, const char * const name)
+{
+	char	ext[PATH_MAX], *p;
+
+	if ((p = strrchr(fn, '.')) != NULL && strchr(p, '/') == NULL) {
+		strlcpy(ext, p, sizeof(ext));
+		*p = '\0';
+	} else
+		*ext = '\0';
+	strlcat(fn, "-", size);
+	strlcat(fn, name, size);
+	strlcat(fn, ext, size);
+}
+
 /*
  *	Pass 1:
  *	  - process all source files
@@ -216,20 +620,37 @@ main(int argc, char *argv[])
 static void
 pass1(void)
 {
-	int	fi;
+	int	fi, n;
 
 	pass = 1;
-	pc = 0;
-	fi = 0;
 	if (ver_flag)
 		fprintf(stdout, "%s\n", "Pass 1");
-	open_o_files(infiles[fi]);
-	while (infiles[fi] != NULL) {
-		if (ver_flag)
-			fprintf(stdout, "   Read    %s\n", infiles[fi]);
-		p1_file(infiles[fi]);
-		fi++;
+	perf_start(PF_PASS1);
+	open_o_files();
+	for (;;) {
+		sect_init();
+		rlx_init();
+		opt_init();
+		for (fi = 0; infiles[fi] != NULL; fi++) {
+			if (ver_flag)
+				fprintf(stdout, "   Read    %s\n", infiles[fi]);
+			perf_begin(infiles[fi], "source");
+			p1_file(infiles[fi]);
+			perf_end(infiles[fi], "source");
+		}
+		if (errors)
+			break;
+		n = rlx_check();
+		if (opt_check() + n == 0)
+			break;
+		clr_sym();		/* repeat with the changed sites */
+		if (defs != NULL)
+			def_syms(defs);
+		src_rewind();
+		obj_rewind();
 	}
+	sect_layout();
+	perf_stop(PF_PASS1);
 	if (errors) {
 		fclose(objfp);
 		unlink(objfn);
@@ -247,14 +668,16 @@ pass1(void)
 void
 p1_file(char * const fn)
 {
+	int	level;
+
+	level = iflevel;	/* file may be INCLUDE'd inside of an IF */
 	c_line = 0;
 	srcfn = fn;
-	if ((srcfp = fopen(fn, "r")) == NULL)
-		fatal(F_FOPEN, fn);
+	srcfp = src_open(fn);
 	while (p1_line())
 		;
 	fclose(srcfp);
-	if (iflevel)
+	if (iflevel > level)
 		asmerr(E_MISEIF);
 }
 
@@ -269,12 +692,12 @@ static int
 p1_line(void)
 {
 	char		*p;
-	int		 i;
 	struct opc	*op;
 
 	if ((p = fgets(line, LINE_MAX, srcfp)) == NULL)
 		return (0);
 	c_line++;
+	perf.pf_lines[0]++;
 	p = get_label(label, p);
 	p = get_opcode(opcode, p);
 	p = get_arg(operand, p);
@@ -282,11 +705,10 @@ p1_line(void)
 		return (0);
 	if (*opcode) {
 		if ((op = search_op(opcode)) != NULL) {
-			i = (*op->op_fun)(op->op_c1, op->op_c2);
-			if (gencode)
-				pc += i;
+			if (gencode || op->op_fun == op_cond)
+				pc += opt_line(op);
 		} else
-			asmerr(E_ILLOPC);
+			asmerr(other_op(opcode) ? E_NOTCPU : E_ILLOPC);
 	} else if (*label)
 		put_label();
 	return (1);
@@ -302,7 +724,10 @@ pass2(void)
 	int	fi;
 
 	pass = 2;
-	pc = 0;
+	perf_start(PF_PASS2);
+	sect_init();
+	rlx_init();
+	opt_init();
 	fi = 0;
 	if (ver_flag)
 		fprintf(stdout, "%s\n", "Pass 2");
@@ -310,11 +735,27 @@ pass2(void)
 	while (infiles[fi] != NULL) {
 		if (ver_flag)
 			fprintf(stdout, "   Read    %s\n", infiles[fi]);
+		perf_begin(infiles[fi], "source");
 		p2_file(infiles[fi]);
+		perf_end(infiles[fi], "source");
 		fi++;
 	}
+	cyc_check();
+	cross_check();
+	if (lint_flag)
+		lint_end();
+	if (prof_flag)
+		prof_end();
+	perf_stop(PF_PASS2);
+	perf_start(PF_OUTPUT);
 	obj_end();
 	fclose(objfp);
+	perf_stop(PF_OUTPUT);
+	if (test_flag && !errors && out_form != OUTREL) {
+		perf_start(PF_TEST);
+		test_run(obj_memory());
+		perf_stop(PF_TEST);
+	}
 	if (ver_flag)
 		fprintf(stdout, "%d error(s)\n", errors);
 }
@@ -330,8 +771,7 @@ p2_file(char * const fn)
 {
 	c_line = 0;
 	srcfn = fn;
-	if ((srcfp = fopen(fn, "r")) == NULL)
-		fatal(F_FOPEN, fn);
+	srcfp = src_open(fn);
 	while (p2_line())
 		;
 	fclose(srcfp);
@@ -349,12 +789,14 @@ p2_line(void)
 {
 	char		*p;
 	int		 op_count;
+	size_t		 n;
 	struct opc	*op;
 
 	if ((p = fgets(line, LINE_MAX, srcfp)) == NULL)
 		return (0);
 	c_line++;
 	s_line++;
+	perf.pf_lines[1]++;
 	p = get_label(label, p);
 	p = get_opcode(opcode, p);
 	p = get_arg(operand, p);
@@ -364,9 +806,27 @@ p2_line(void)
 	}
 	if (*opcode) {
 		op = search_op(opcode);
-		op_count = (*op->op_fun)(op->op_c1, op->op_c2);
+		if (!gencode && op->op_fun != op_cond) {
+			/* skipped by conditional assembly, don't evaluate */
+			sd_flag = 2;
+			lst_line(0, 0);
+			return (1);
+		}
+		ev_pend = 0;
+		op_count = opt_line(op);
+		if (ev_pend && op_count)	/* relocatable byte */
+			asmerr(E_ILLREL);
+		if (op_count && sect_bss())
+			asmerr(E_BSSDAT);
 		if (gencode) {
+			n = (op->op_fun == op_db || op->op_fun == op_dm ||
+			    op->op_fun == op_dw) ? 0 : (size_t)op_count;
+			cyc_line(n);
+			if (prof_flag)
+				prof_line(op, n);
 			lst_line(pc, op_count);
+			if (lint_flag)
+				lint_line(op, op_count);
 			obj_writeb((size_t)op_count);
 			pc += op_count;
 		} else {
@@ -374,6 +834,11 @@ p2_line(void)
 			lst_line(0, 0);
 		}
 	} else {
+		cyc_line(0);
+		if (prof_flag)
+			prof_line(NULL, 0);
+		if (lint_flag)
+			lint_line(NULL, 0);
 		sd_flag = 2;
 		lst_line(0, 0);
 	}
@@ -381,41 +846,58 @@ p2_line(void)
 }
 
 /*
- *	open output files:
+ *	get names of output files:
  *	input is filename of source file
  *	list and object filenames are built from source filename if
  *	not given by options
  */
 static void
-open_o_files(const char * const source)
+get_o_names(const char * const source)
 {
 	char	*p;
 
 	if (*objfn == '\0') {
 		strlcpy(objfn, source, sizeof(objfn));
-		if ((p = strrchr(objfn, '.')) != NULL) {
-			if (out_form == OUTHEX)
-				strlcpy(p, OBJEXTHEX, sizeof(objfn));
-			else
-				strlcpy(p, OBJEXTBIN, sizeof(objfn));
-		} else {
-			if (out_form == OUTHEX)
-				strlcat(objfn, OBJEXTHEX, sizeof(objfn));
-			else
-				strlcat(objfn, OBJEXTBIN, sizeof(objfn));
-		}
+		if ((p = strrchr(objfn, '.')) != NULL)
+			strlcpy(p, obj_ext(), sizeof(objfn));
+		else
+			strlcat(objfn, obj_ext(), sizeof(objfn));
+	}
+	if (list_flag && *lstfn == '\0') {
+		strlcpy(lstfn, source, sizeof(lstfn));
+		if ((p = strrchr(lstfn, '.')) != NULL)
+			strlcpy(p, LSTEXT, sizeof(lstfn));
+		else
+			strlcat(lstfn, LSTEXT, sizeof(lstfn));
 	}
+}
+
+/*
+ *	filename extension of object file for the output format
+ */
+static const char *
+obj_ext(void)
+{
+	switch (out_form) {
+	case OUTHEX:
+		return (OBJEXTHEX);
+	case OUTREL:
+		return (OBJEXTREL);
+	default:
+		return (OBJEXTBIN);
+	}
+}
+
+/*
+ *	open output files
+ */
+static void
+open_o_files(void)
+{
 	if ((objfp = fopen(objfn, "w")) == NULL)
 		fatal(F_FOPEN, objfn);
 
 	if (list_flag) {
-		if (*lstfn == '\0') {
-			strlcpy(lstfn, source, sizeof(lstfn));
-			if ((p = strrchr(lstfn, '.')) != NULL)
-				strlcpy(p, LSTEXT, sizeof(lstfn));
-			else
-				strlcat(lstfn, LSTEXT, sizeof(lstfn));
-		}
 		if ((lstfp = fopen(lstfn, "w")) == NULL)
 			fatal(F_FOPEN, lstfn);
 		errfp = lstfp;
@@ -423,23 +905,16 @@ open_o_files(const char * const source)
 }
 
 /*
- *	create a filename in "dest" from "src" and "ext"
+ *	create a filename in "dest" of size "size" from "src" and "ext"
  */
 static void
-get_fn(char * const dest, char * const src, const char * const ext)
+get_fn(char * const dest, const size_t size, char * const src,
+    const char * const ext)
 {
-	int	 i;
-	char	*sp, *dp;
-
-	i = 0;
-	sp = src;
-	dp = dest;
-	while ((i++ < PATH_MAX) && (*sp != '\0'))
-		*dp++ = *sp++;
-	*dp = '\0';
+	strlcpy(dest, src, size);
 	if ((strrchr(dest, '.') == NULL) &&
-	    (strlen(dest) <= (PATH_MAX - strlen(ext))))
-		strlcat(dest, ext, sizeof(dest));
+	    (strlen(dest) + strlen(ext) < size))
+		strlcat(dest, ext, size);
 }
 
 /*
@@ -537,7 +1012,12 @@ static void
 usage(void)
 {
 	(void)fprintf(stderr,
-	    "usage: %s [-b length] [-f b|h|m] [-l [listfile]] [-o outfile] "
-	    "[-s a|n] [-v] [-x] filename ...\n", __progname);
+	    "usage: %s [-b length] [-C cachedir] [-c z80|z180|z80n] "
+	    "[-D name[=value]] [-d depfile] [-e entry] [-f b|h|m|r] "
+	    "[-g tracefile] [-H] [-j] [-k symbol] [-L origin] "
+	    "[-l [listfile]] [-M cachesize] [-O] [-o outfile] [-P profile] "
+	    "[-p] [-s a|n] [-T t|j] [-t] [-U] [-u] [-V name:defs | @file] "
+	    "[-v] [-W] [-x] filename ...\n",
+	    __progname);
 	exit(1);
 }
@@ -34,15 +34,20 @@
 #define SRCEXT		".asm"	/* filename extension source */
 #define OBJEXTBIN	".bin"	/* filename extension object */
 #define OBJEXTHEX	".hex"	/* filename extension hex */
+#define OBJEXTREL	".rel"	/* filename extension relocatable object */
 #define LSTEXT		".lst"	/* filename extension listing */
+#define PCHEXT		".sym"	/* filename extension symbol image */
 #define ENDFILE		"END"	/* end of source */
-#define MAXFN		512	/* max. no. source files */
 #define SYMSIZE		8	/* max. symbol length */
-#define INCNEST		5	/* max. INCLUDE nesting depth */
-#define IFNEST		5	/* max IF.. nesting depth */
+#define NESTINC		8	/* growth of INCLUDE and IF.. stacks */
 #define HASHSIZE	500	/* max. entries in symbol hash array */
 #define OPCARRAY	256	/* size of object buffer */
 #define SYMINC		100	/* start size of sorted symbol array */
+#define CACHEMAX	65536	/* default max. size of build cache in KB */
+#define RELMAGIC	"ZZ80REL" /* magic of relocatable objects */
+#define RELVERS		1	/* version of relocatable objects */
+
+#define ALIGNUP(a, n)	(((a) + (n) - 1) & ~((n) - 1)) /* align a to n */
 
 enum {
 	COMMENT		= ';',	/* inline comment character */
@@ -54,7 +59,24 @@ enum {
 enum {
 	OUTBIN,			/* format of object: binary */
 	OUTMOS,			/* format of object: Mostek binary */
-	OUTHEX			/* format of object: Intel hex */
+	OUTHEX,			/* format of object: Intel hex */
+	OUTREL			/* format of object: relocatable */
+};
+
+enum {
+	PF_PASS1,		/* phase of -T: pass 1 */
+	PF_PASS2,		/* phase of -T: pass 2 */
+	PF_OUTPUT,		/* phase of -T: flushing the object */
+	PF_TEST,		/* phase of -T: tests of -u */
+	PF_SORT,		/* phase of -T: sorting the symbols */
+	PF_LIST,		/* phase of -T: listing the symbols */
+	PF_NPHASE		/* no. of phases */
+};
+
+enum {
+	CPUZ80,			/* instruction set: Z80 */
+	CPUZ180,		/* instruction set: Z180/HD64180 */
+	CPUZ80N			/* instruction set: Z80N, ZX Spectrum Next */
 };
 
 /*
@@ -86,6 +108,10 @@ enum {
 	REGIIX		= 19,	/* register indirect IX */
 	REGIIY		= 20,	/* register indirect IY */
 	REGISP		= 21,	/* register indirect SP */
+	REGIXH		= 22,	/* register IXH, undocumented */
+	REGIXL		= 23,	/* register IXL, undocumented */
+	REGIYH		= 24,	/* register IYH, undocumented */
+	REGIYL		= 25,	/* register IYL, undocumented */
 	FLGNC		= 30,	/* flag no carry */
 	FLGNZ		= 31,	/* flag not zero */
 	FLGZ		= 32,	/* flag zero */
@@ -111,9 +137,18 @@ enum err_type {
 	E_MISHYP	= 7,	/* missing string separator */
 	E_MEMOVR	= 8,	/* memory override (ORG) */
 	E_MISIFF	= 9,	/* missing IF at ELSE or ENDIF */
-	E_IFNEST	= 10,	/* to many IF's nested */
-	E_MISEIF	= 11,	/* missing ENDIF */
-	E_INCNEST	= 12	/* to many INCLUDE's nested */
+	E_MISEIF	= 10,	/* missing ENDIF */
+	E_INCREC	= 11,	/* recursive INCLUDE */
+	E_ILLREL	= 12,	/* illegal use of relocatable value */
+	E_ILLORG	= 13,	/* ORG in section not yet placed */
+	E_BSSDAT	= 14,	/* data in uninitialised section */
+	E_PGCROS	= 15,	/* region crosses a page */
+	E_NOTALN	= 16,	/* address not aligned */
+	E_MISNCR	= 17,	/* unmatched NOCROSS or ENDCROSS */
+	E_BUDGET	= 18,	/* T-states out of budget */
+	E_MISTST	= 19,	/* USET or UEXPECT without UTEST */
+	E_TEST		= 20,	/* test failed */
+	E_NOTCPU	= 21	/* opcode not in instruction set of CPU */
 };
 
 /*
@@ -151,6 +186,9 @@ struct sym {
 	struct	 sym *sym_next;	/* next entry */
 	char	*sym_name;	/* symbol name */
 	int	 sym_val;	/* symbol value */
+	size_t	 sym_line;	/* line no. of definition */
+	int	 sym_sect;	/* section of value, 0 if absolute */
+	int	 sym_ext;	/* no. of external symbol, 0 if none */
 };
 
 /*
@@ -162,6 +200,49 @@ struct inc {
 	size_t	 inc_line;	/* line counter for listing */
 };
 
+/*
+ *	structure for sections
+ */
+struct sect {
+	char	 sc_name[SYMSIZE + 1];	/* name of section */
+	int	 sc_bss;	/* uninitialised, not written into object */
+	int	 sc_org;	/* address set by ORG, or -1, lowest of CODE */
+	int	 sc_align;	/* alignment of the address */
+	int	 sc_pc;		/* program counter while not current */
+	int	 sc_size;	/* size of section after pass 1 */
+	int	 sc_base;	/* address of section */
+	char	*sc_file;	/* file of SECTION or ORG, for errors */
+	size_t	 sc_line;	/* line no. of SECTION or ORG */
+};
+
+/*
+ *	structure for the state of the Z80 interpreter
+ */
+struct cpu {
+	unsigned char	*cp_mem;	/* 64 KB of memory */
+	uint8_t		 cp_reg[8];	/* B, C, D, E, H, L, F, A */
+	uint8_t		 cp_alt[8];	/* B', C', D', E', H', L', F', A' */
+	int		 cp_ix, cp_iy;	/* index registers */
+	int		 cp_sp, cp_pc;	/* stack pointer, program counter */
+	uint8_t		 cp_i, cp_r;	/* interrupt vector, refresh */
+	uint8_t		 cp_iff, cp_im;	/* interrupts enabled, mode */
+	uint8_t		 cp_halt;	/* stopped at HALT */
+};
+
+/*
+ *	structure for the counters of option -T
+ */
+struct perf {
+	unsigned long	 pf_lines[2];	/* lines read in pass 1 and 2 */
+	unsigned long	 pf_search;	/* calls of search_op() */
+	unsigned long	 pf_getreg;	/* calls of get_reg() */
+	unsigned long	 pf_getsym;	/* calls of get_sym() */
+	unsigned long	 pf_probes;	/* symbols compared by get_sym() */
+	unsigned long	 pf_eval;	/* expressions evaluated */
+	int		 pf_depth;	/* current recursion of expr() */
+	int		 pf_maxdepth;	/* max. recursion of expr() */
+};
+
 /*
  *	global variables other than CPU specific tables
  */
@@ -182,7 +263,17 @@ extern int	 ops[OPCARRAY];	/* buffer for generated object code */
 extern uint8_t	 list_flag;	/* flag for option -l */
 extern uint8_t	 ver_flag;	/* flag for option -v */
 extern uint8_t	 dump_flag;	/* flag for option -x */
+extern uint8_t	 pack_flag;	/* flag for option -p */
+extern uint8_t	 cyc_flag;	/* flag for option -t */
+extern uint8_t	 relax_flag;	/* flag for option -j */
+extern uint8_t	 opt_flag;	/* flag for option -O */
+extern uint8_t	 lint_flag;	/* flag for option -W */
+extern uint8_t	 test_flag;	/* flag for option -u */
+extern uint8_t	 prof_flag;	/* flag for option -P */
+extern uint8_t	 undoc_flag;	/* flag for option -U */
+extern uint8_t	 opt_mark;	/* line rewritten by -O */
 extern int	 pc;		/* program counter */
+extern int	 cursect;	/* current section, 0 if absolute */
 extern uint8_t	 pass;		/* processed pass */
 extern int	 iflevel;	/* IF nesting level */
 extern int	 gencode;	/* flag for conditional object code */
@@ -196,6 +287,7 @@ extern uint8_t	 sd_flag;	/* list flag for PSEUDO opcodes */
 extern int	 sd_val;	/* output value for PSEUDO opcodes */
 extern int	 prg_adr;	/* start address of program */
 extern uint8_t	 out_form;	/* format of object file */
+extern uint8_t	 cpu_type;	/* instruction set of option -c */
 
 extern size_t	 c_line;	/* current line no. in current source */
 extern size_t	 s_line;	/* line no. counter for listing */
@@ -206,24 +298,92 @@ extern size_t	 datalen;	/* number of bytes per hex record */
 extern struct	sym *symtab[HASHSIZE];	/* symbol table */
 extern struct	sym **symarray;		/* sorted symbol table */
 
+extern int	 ev_sect;	/* section of last expression */
+extern int	 ev_ext;	/* external symbol of last expression */
+extern int	 ev_pend;	/* relocatable values not yet output */
+extern int	 ev_late;	/* last expression depends on placement */
+
+extern struct perf perf;	/* counters of option -T */
+
 /*
  *	function prototypes
  */
+/* cache.c */
+uint64_t	fnv_hash(uint64_t, const void * const, const size_t);
+uint64_t	cache_key(char ** const, const int, const char * const);
+int		cache_get(const char * const, const uint64_t,
+		    const char * const, const char * const);
+void		cache_put(const char * const, const uint64_t,
+		    const char * const, const char * const, const size_t);
+void		cache_stats(const char * const, const size_t);
+
+/* cyc.c */
+int		 cyc_count(const int * const, const size_t, int * const);
+void		 cyc_line(const size_t);
+const char	*cyc_list(void);
+void		 cyc_budget(const int, const int, const int, const int);
+void		 cyc_check(void);
+
+/* emu.c */
+void	emu_init(void);
+int	emu_step(struct cpu * const);
+
+/* link.c */
+int	link_files(char ** const, const int, const char * const,
+	    const char * const, char ** const);
+
+/* lint.c */
+void	lint_line(const struct opc * const, const int);
+void	lint_end(void);
+
 /* num.c */
 int	eval(const char *);
+int	eval_pc(const char *);
+int	eval_fixed(const char *);
+int	eval_quiet(const char *);
 int	chk_v1(const int);
 int	chk_v2(const int);
 
+/* opt.c */
+void	opt_init(void);
+void	opt_set(const int);
+int	opt_line(const struct opc * const);
+int	opt_check(void);
+
 /* out.c */
 void 	asmerr(enum err_type);
+void 	asmerr_adr(enum err_type, const int, const int);
+void 	asmerr_at(enum err_type, const char * const, const size_t,
+	    const char * const);
 void 	lst_header(void);
 void 	lst_attl(void);
 void 	lst_line(const int, int);
 void 	lst_sort_sym(const size_t);
 void 	obj_header(void);
 void 	obj_end(void);
+void 	obj_image(const unsigned char * const, const unsigned char * const,
+	    const int, const int);
 void 	obj_writeb(size_t);
 void 	obj_fill(int);
+void 	obj_reloc(const int);
+int 	obj_extern(const char * const);
+void 	obj_public(struct sym * const);
+void 	obj_rewind(void);
+const unsigned char *obj_memory(void);
+void 	dep_write(const char * const, const char * const, const char * const);
+
+/* pch.c */
+int	pch_write(char * const);
+int	pch_load(char * const);
+
+/* perf.c */
+void		 perf_start(const int);
+void		 perf_stop(const int);
+void		 perf_print(const int, const char * const, const char * const);
+void		 perf_trace(const char * const, const char * const);
+void		 perf_begin(const char * const, const char * const);
+void		 perf_end(const char * const, const char * const);
+void		 perf_close(void);
 
 /* pfun.c */
 int 	op_org(void);
@@ -236,6 +396,14 @@ int 	op_dw(void);
 int 	op_misc(const int);
 int 	op_cond(const int);
 int 	op_glob(const int);
+int 	op_sect(void);
+int 	op_align(void);
+int 	op_aligned(void);
+int 	op_cross(const int);
+void	cross_check(void);
+int 	op_cycles(void);
+int 	op_opt(const int);
+int 	op_test(const int);
 
 /* rfun.c */
 int 	op_1b(const int), op_2b(const int, const int), op_pupo(const int);
@@ -244,19 +412,65 @@ int 	op_jp(void), op_jr(void), op_djnz(void), op_rst(void);
 int 	op_add(void), op_adc(void), op_sub(void), op_sbc(void), op_cp(void);
 int 	op_inc(void), op_dec(void), op_or(void), op_xor(void), op_and(void);
 int 	op_rl(void), op_rr(void), op_sla(void), op_sra(void), op_srl(void);
-int 	op_rlc(void), op_rrc(void);
+int 	op_rlc(void), op_rrc(void), op_sll(void);
+int 	op_mlt(void), op_tst(void), op_tstio(void), op_in0(void), op_out0(void);
+int 	op_ntest(void), op_nreg(void);
 int 	op_out(void), op_in(void), op_im(void);
 int 	op_set(void), op_res(void), op_bit(void);
 
+/* prof.c */
+void		 prof_load(const char * const);
+void		 prof_line(const struct opc * const, const size_t);
+const char	*prof_list(void);
+void		 prof_end(void);
+
+/* rlx.c */
+void	rlx_init(void);
+int	rlx_long(const char * const);
+int	rlx_check(void);
+
+/* sect.c */
+void		 sect_init(void);
+void		 sect_switch(const char * const, const int);
+int		 sect_org(const int);
+int		 sect_align(const int);
+void		 sect_layout(void);
+size_t		 sect_cur(void);
+int		 sect_bss(void);
+struct sect	*sect_get(const size_t);
+int		 sect_addr(const int);
+
+/* src.c */
+FILE		*src_open(const char * const);
+int		 src_skip(const char * const, const int);
+int		 src_same(const char * const, const char * const);
+int		 src_equonly(const char * const);
+uint64_t	 src_hash(const char * const);
+void		 src_mark(const char * const);
+void		 src_rewind(void);
+const char	*src_name(const size_t);
+void		 src_list(FILE * const);
+
 /* tab.c */
 struct opc	*search_op(const char * const);
+int		 other_op(const char * const);
 struct sym	*get_sym(const char * const);
+struct sym	*find_sym(const char * const, unsigned long * const);
 int		 put_sym(const char * const, const int);
 int		 get_reg(const char * const);
 void		 put_label(void);
+void		 set_rel(const char * const);
+void		*grow_tab(void *, size_t * const, const size_t);
+void		 clr_sym(void);
 size_t		 copy_sym(void);
 void		 sort_sym(const size_t, int);
 
+/* test.c */
+int	test_reg(const char * const);
+void	test_begin(const int, const unsigned long);
+int	test_value(const int, const int, const int, const long);
+void	test_run(const unsigned char * const);
+
 /* zz80asm.c */
 void 	fatal(enum fatal_type, const char * const)__attribute__((noreturn));
 void 	p1_file(char * const);